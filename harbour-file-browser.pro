@@ -76,6 +76,21 @@ CONFIG += sailfishapp
 SOURCES += src/harbour-file-browser.cpp \
     src/filemodel.cpp \
     src/filemodelworker.cpp \
+    src/directorylister.cpp \
+    src/entrytable.cpp \
+    src/entrydiff.cpp \
+    src/directorycache.cpp \
+    src/directorywatcher.cpp \
+    src/refreshscheduler.cpp \
+    src/entryfilter.cpp \
+    src/childcounter.cpp \
+    src/doomedregistry.cpp \
+    src/displaystringswatcher.cpp \
+    src/mimeservice.cpp \
+    src/usernamecache.cpp \
+    src/filecopier.cpp \
+    src/transferplan.cpp \
+    src/transferjournal.cpp \
     src/filedata.cpp \
     src/engine.cpp \
     src/fileworker.cpp \
@@ -88,6 +103,21 @@ SOURCES += src/harbour-file-browser.cpp \
 
 HEADERS += src/filemodel.h \
     src/filemodelworker.h \
+    src/directorylister.h \
+    src/entrytable.h \
+    src/entrydiff.h \
+    src/directorycache.h \
+    src/directorywatcher.h \
+    src/refreshscheduler.h \
+    src/entryfilter.h \
+    src/childcounter.h \
+    src/doomedregistry.h \
+    src/displaystringswatcher.h \
+    src/mimeservice.h \
+    src/usernamecache.h \
+    src/filecopier.h \
+    src/transferplan.h \
+    src/transferjournal.h \
     src/filedata.h \
     src/engine.h \
     src/fileworker.h \
@@ -48,6 +48,11 @@ ListItem {
         });
     }
 
+    onPressed: {
+        // start loading the folder before it is opened
+        if (isDir && fileModel.selectedFileCount === 0) fileModel.prefetch(index);
+    }
+
     onClicked: {
         if (fileModel.selectedFileCount > 0) {
             toggleSelection(index);
@@ -41,6 +41,10 @@ Item {
     // open status of the panel
     property alias open: dockedPanel.open
 
+    // shows a button to pause and resume the operation
+    property bool pausable: false
+    property bool paused: false
+
     // shows the panel
     function showText(txt) {
         headerText = txt;
@@ -56,6 +60,10 @@ Item {
     // cancelled signal is emitted when user presses the cancel button
     signal cancelled
 
+    // emitted when user presses the pause button
+    signal pauseRequested
+    signal resumeRequested
+
 
     //// internal
 
@@ -109,13 +117,23 @@ Item {
                 onClicked: cancelled();
             }
         }
+        IconButton {
+            id: pauseButton
+            visible: progressPanel.pausable
+            anchors.right: cancelButton.left
+            anchors.verticalCenter: parent.verticalCenter
+            width: visible ? Theme.itemSizeMedium : 0
+            icon.width: Theme.iconSizeMedium; icon.height: Theme.iconSizeMedium
+            icon.source: progressPanel.paused ? "image://theme/icon-m-play" : "image://theme/icon-m-pause"
+            onClicked: progressPanel.paused ? resumeRequested() : pauseRequested()
+        }
         Label {
             id: progressHeader
             visible: dockedPanel.open
 
             y: 2*Theme.paddingLarge
             anchors.left: parent.left
-            anchors.right: cancelButton.left
+            anchors.right: pauseButton.left
             anchors.leftMargin: progressBusy.width + Theme.paddingLarge*4
             anchors.rightMargin: Theme.paddingLarge
             text: progressPanel.headerText
@@ -125,7 +143,7 @@ Item {
             id: progressText
             visible: dockedPanel.open
             anchors.left: progressHeader.left
-            anchors.right: cancelButton.left
+            anchors.right: pauseButton.left
             anchors.rightMargin: Theme.paddingLarge
             anchors.top: progressHeader.bottom
             text: progressPanel.text
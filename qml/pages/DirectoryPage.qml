@@ -97,6 +97,11 @@ Page {
         onTriggered: remorsePopupActive = false
     }
 
+    RemorsePopup {
+        id: resumeRemorsePopup
+        onCanceled: engine.discardInterruptedTransfer()
+    }
+
     SilicaListView {
         id: fileList
         anchors.fill: parent
@@ -108,6 +113,8 @@ Page {
         Behavior on opacity { NumberAnimation { duration: 300 } }
 
         model: fileModel
+        onMovementStarted: fileModel.cancelPrefetch()
+        onMovementEnded: fileModel.prefetchWhenIdle()
 
         VerticalScrollDecorator { flickable: fileList }
 
@@ -467,7 +474,11 @@ Page {
     ProgressPanel {
         id: progressPanel
         page: page
+        pausable: true
+        paused: engine.paused
         onCancelled: engine.cancel()
+        onPauseRequested: engine.pause()
+        onResumeRequested: engine.resume()
     }
 
     Loader {
@@ -542,6 +553,13 @@ Page {
                 pageStack.pushAttached(Qt.resolvedUrl("ShortcutsPage.qml"), { currentPath: dir });
             }
             coverText = Paths.lastPartOfPath(page.dir)+"/"; // update cover
+
+            if (engine.interruptedTransfer && !resumeRemorsePopup.active) {
+                resumeRemorsePopup.execute(qsTr("Resuming interrupted transfer"), function() {
+                    progressPanel.showText(qsTr("Resuming"));
+                    engine.resumeInterruptedTransfer();
+                });
+            }
         } else if (status === PageStatus.Activating) {
             console.log("page: activating --", dir);
             main.activePage = {type: "dir", path: dir};
@@ -56,6 +56,7 @@ Page {
 
                 model: ListModel {
                     ListElement { label: qsTr("Name"); value: "name" }
+                    ListElement { label: qsTr("Name (natural)"); value: "natural" }
                     ListElement { label: qsTr("Size"); value: "size" }
                     ListElement { label: qsTr("Modification time"); value: "modificationtime" }
                     ListElement { label: qsTr("File type"); value: "type" }
@@ -0,0 +1,142 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <QCache>
+#include <QPair>
+#include <QFile>
+#include <QRunnable>
+#include "childcounter.h"
+
+// Number of folders whose counts are kept.
+#ifndef CHILDCOUNTER_CACHE_SIZE
+#define CHILDCOUNTER_CACHE_SIZE 4096
+#endif
+
+// Folders counted at the same time. Counting is mostly waiting for I/O.
+#ifndef CHILDCOUNTER_THREADS
+#define CHILDCOUNTER_THREADS 2
+#endif
+
+namespace {
+// Inode numbers are only unique per device: the roots of mounted file
+// systems commonly share the same inode, for example. All parts are
+// taken from the folder itself, or from the target of a symlink.
+typedef QPair<QPair<quint64, quint64>, qint64> CountKey; // device and inode, modification time
+
+// only used on the main thread
+QCache<CountKey, int>& countCache()
+{
+    static QCache<CountKey, int> cache(CHILDCOUNTER_CACHE_SIZE);
+    return cache;
+}
+
+class CountJob : public QRunnable
+{
+public:
+    CountJob(ChildCounter* receiver, QString path, quint64 device, quint64 inode, qint64 modTime, int row) :
+        m_receiver(receiver), m_path(path), m_device(device), m_inode(inode), m_modTime(modTime), m_row(row) {
+        setAutoDelete(true);
+    }
+
+    void run() override {
+        // Unreadable folders are shown as empty, as before. Like QDir without
+        // QDir::System, hidden entries are counted, but not devices, fifos,
+        // sockets, or broken symlinks.
+        int count = 0;
+
+        if (DIR* dir = opendir(QFile::encodeName(m_path).constData())) {
+            while (struct dirent* entry = readdir(dir)) {
+                if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+                if (entry->d_type == DT_DIR || entry->d_type == DT_REG) {
+                    ++count;
+                } else if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+                    // only symlinks and unknown types need to be stat'ed
+                    struct stat statData;
+                    if (fstatat(dirfd(dir), entry->d_name, &statData, 0) == 0
+                            && (S_ISDIR(statData.st_mode) || S_ISREG(statData.st_mode))) {
+                        ++count;
+                    }
+                }
+            }
+            closedir(dir);
+        }
+
+        // The receiver waits for all jobs before it is deleted, and
+        // queued calls to a deleted object are dropped by Qt.
+        QMetaObject::invokeMethod(m_receiver, "jobDone", Qt::QueuedConnection,
+                                  Q_ARG(QString, m_path), Q_ARG(quint64, m_device),
+                                  Q_ARG(quint64, m_inode), Q_ARG(qint64, m_modTime),
+                                  Q_ARG(int, m_row), Q_ARG(int, count));
+    }
+
+private:
+    ChildCounter* m_receiver;
+    QString m_path;
+    quint64 m_device;
+    quint64 m_inode;
+    qint64 m_modTime;
+    int m_row;
+};
+}
+
+ChildCounter::ChildCounter(QObject *parent) : QObject(parent)
+{
+    m_pool.setMaxThreadCount(CHILDCOUNTER_THREADS);
+}
+
+ChildCounter::~ChildCounter()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+int ChildCounter::count(const QString& path, quint64 device, quint64 inode, qint64 modTime, int row)
+{
+    if (int* cached = countCache().object(qMakePair(qMakePair(device, inode), modTime))) {
+        return *cached;
+    }
+
+    if (!m_pending.contains(path)) {
+        m_pending.insert(path);
+        m_pool.start(new CountJob(this, path, device, inode, modTime, row));
+    }
+
+    return -1;
+}
+
+void ChildCounter::cancelPending()
+{
+    // jobs that are already running still report their results
+    m_pool.clear();
+    m_pending.clear();
+}
+
+void ChildCounter::jobDone(QString path, quint64 device, quint64 inode, qint64 modTime, int row, int count)
+{
+    m_pending.remove(path);
+    countCache().insert(qMakePair(qMakePair(device, inode), modTime), new int(count));
+    emit countReady(path, device, inode, modTime, row, count);
+}
@@ -0,0 +1,67 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef CHILDCOUNTER_H
+#define CHILDCOUNTER_H
+
+#include <QObject>
+#include <QString>
+#include <QSet>
+#include <QThreadPool>
+
+/**
+ * @brief The ChildCounter class counts the entries of folders in the background.
+ *
+ * Counts are cached by the device, inode and modification time of the folder,
+ * so they stay valid until an entry is added to or removed from it. The
+ * cache is shared by all instances. Folders that are not cached yet are
+ * counted by a small thread pool, and the result is reported using
+ * countReady(). Until then, callers should show an estimate.
+ */
+class ChildCounter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ChildCounter(QObject *parent = nullptr);
+    ~ChildCounter();
+
+    // Returns the number of entries including hidden entries, or -1 if the
+    // folder has not been counted yet. In this case, it is queued for counting.
+    // The row is passed back with countReady() so callers can find the entry
+    // without searching for it; it may be outdated by then.
+    int count(const QString& path, quint64 device, quint64 inode, qint64 modTime, int row);
+
+    // drops all queued folders, e.g. when a different folder is shown
+    void cancelPending();
+
+signals:
+    void countReady(QString path, quint64 device, quint64 inode, qint64 modTime, int row, int count);
+
+private slots:
+    void jobDone(QString path, quint64 device, quint64 inode, qint64 modTime, int row, int count);
+
+private:
+    QThreadPool m_pool;
+    QSet<QString> m_pending;
+};
+
+#endif // CHILDCOUNTER_H
@@ -0,0 +1,148 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <QDir>
+#include <QMutexLocker>
+#include "directorycache.h"
+
+// Memory used by all cached listings together, in bytes.
+#ifndef DIRECTORYCACHE_MEMORY_BUDGET
+#define DIRECTORYCACHE_MEMORY_BUDGET (8*1024*1024)
+#endif
+
+namespace {
+qint64 modTimeOf(const struct stat& data)
+{
+    return qint64(data.st_mtim.tv_sec) * 1000000000LL + data.st_mtim.tv_nsec;
+}
+}
+
+DirectoryCache* DirectoryCache::instance()
+{
+    static DirectoryCache cache;
+    return &cache;
+}
+
+DirectoryCache::DirectoryCache()
+{
+    m_cache.setMaxCost(int(DIRECTORYCACHE_MEMORY_BUDGET / 1024));
+}
+
+QString DirectoryCache::normalizedPath(const QString& path)
+{
+    QString canonical = QDir(path).canonicalPath();
+    return canonical.isEmpty() ? QDir::cleanPath(path) : canonical;
+}
+
+bool DirectoryCache::peek(const QString& path, const QString& viewSignature, EntryTable& entries)
+{
+    QString key = normalizedPath(path);
+    QMutexLocker locker(&m_mutex);
+
+    // QCache::object() marks the entry as recently used
+    Entry* entry = m_cache.object(key);
+    if (!entry || entry->viewSignature != viewSignature) return false;
+
+    entries = entry->view;
+    return true;
+}
+
+bool DirectoryCache::find(const QString& path, const struct stat& dirStat,
+                          EntryTable& entries, QString& sortSignature)
+{
+    QString key = normalizedPath(path);
+    QMutexLocker locker(&m_mutex);
+
+    Entry* entry = m_cache.object(key);
+    if (!entry
+            || entry->device != dirStat.st_dev
+            || entry->inode != dirStat.st_ino
+            || entry->modTime != modTimeOf(dirStat)) {
+        m_misses.ref();
+        return false;
+    }
+
+    m_hits.ref();
+    entries = entry->entries;
+    sortSignature = entry->sortSignature;
+    return true;
+}
+
+bool DirectoryCache::contains(const QString& path, const struct stat& dirStat)
+{
+    QString key = normalizedPath(path);
+    QMutexLocker locker(&m_mutex);
+
+    Entry* entry = m_cache.object(key);
+    return entry
+            && entry->device == dirStat.st_dev
+            && entry->inode == dirStat.st_ino
+            && entry->modTime == modTimeOf(dirStat);
+}
+
+void DirectoryCache::insert(const QString& path, const struct stat& dirStat,
+                            const EntryTable& entries, const QString& sortSignature,
+                            const EntryTable& view, const QString& viewSignature)
+{
+    Entry* entry = new Entry;
+    entry->entries = entries;
+    entry->view = view;
+    entry->sortSignature = sortSignature;
+    entry->viewSignature = viewSignature;
+    entry->device = dirStat.st_dev;
+    entry->inode = dirStat.st_ino;
+    entry->modTime = modTimeOf(dirStat);
+
+    // an unfiltered view shares its data with the listing
+    qint64 bytes = entries.estimatedMemoryUsage();
+    if (view.count() != entries.count()) bytes += view.estimatedMemoryUsage();
+    int cost = int(qMax(Q_INT64_C(1), bytes / 1024));
+    QString key = normalizedPath(path);
+    QMutexLocker locker(&m_mutex);
+
+    // listings larger than the whole budget are not cached,
+    // QCache deletes the entry in this case
+    m_cache.insert(key, entry, cost);
+}
+
+void DirectoryCache::remove(const QString& path)
+{
+    QString key = normalizedPath(path);
+    QMutexLocker locker(&m_mutex);
+    m_cache.remove(key);
+}
+
+void DirectoryCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+}
+
+void DirectoryCache::setMemoryBudget(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(int(bytes / 1024));
+}
+
+qint64 DirectoryCache::memoryBudget() const
+{
+    QMutexLocker locker(&m_mutex);
+    return qint64(m_cache.maxCost()) * 1024;
+}
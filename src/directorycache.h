@@ -0,0 +1,97 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIRECTORYCACHE_H
+#define DIRECTORYCACHE_H
+
+#include <sys/stat.h>
+#include <QString>
+#include <QCache>
+#include <QMutex>
+#include <QAtomicInt>
+#include "entrytable.h"
+
+/**
+ * @brief The DirectoryCache class keeps recently loaded directory listings.
+ *
+ * Listings are stored by canonical path together with the inode and
+ * modification time of the directory at the moment it was read. A cached
+ * listing is only valid as long as these are unchanged. The unfiltered
+ * listing is kept with the order it was sorted in, so that changing the
+ * filter or the sorting does not require reading the directory again.
+ * The filtered view that was shown last is kept as well, together with
+ * a signature of the settings it was made with.
+ *
+ * The least recently used listings are dropped when the cache grows
+ * beyond its memory budget. All methods are thread-safe.
+ */
+class DirectoryCache
+{
+public:
+    static DirectoryCache* instance();
+
+    // Returns the last shown view of this path without validating it
+    // against the directory. Used to show something immediately while the
+    // directory is checked. Views made with a different 'viewSignature',
+    // i.e. other hidden files, filter or sorting settings, are not returned.
+    bool peek(const QString& path, const QString& viewSignature, EntryTable& entries);
+
+    // Returns the unfiltered listing if it is still valid for the current
+    // state of the directory. 'sortSignature' describes its order.
+    bool find(const QString& path, const struct stat& dirStat,
+              EntryTable& entries, QString& sortSignature);
+    // like find(), but without copying the listing or counting a hit or miss
+    bool contains(const QString& path, const struct stat& dirStat);
+
+    // 'dirStat' must be taken before the directory is read, so that
+    // changes made while reading invalidate the entry.
+    void insert(const QString& path, const struct stat& dirStat,
+                const EntryTable& entries, const QString& sortSignature,
+                const EntryTable& view, const QString& viewSignature);
+    void remove(const QString& path);
+    void clear();
+
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const;
+
+    int hits() const { return m_hits.loadAcquire(); }
+    int misses() const { return m_misses.loadAcquire(); }
+
+private:
+    explicit DirectoryCache();
+    static QString normalizedPath(const QString& path);
+
+    struct Entry {
+        EntryTable entries; // unfiltered
+        EntryTable view; // filtered
+        QString sortSignature;
+        QString viewSignature;
+        dev_t device;
+        ino_t inode;
+        qint64 modTime; // nanoseconds since epoch
+    };
+
+    mutable QMutex m_mutex;
+    QCache<QString, Entry> m_cache; // cost in KiB
+    QAtomicInt m_hits = {0};
+    QAtomicInt m_misses = {0};
+};
+
+#endif // DIRECTORYCACHE_H
@@ -0,0 +1,339 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <QFile>
+#include <QCoreApplication>
+#include <QVector>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include "directorylister.h"
+
+// Directories with more entries than this are stat'ed in parallel.
+#ifndef DIRECTORYLISTER_PARALLEL_THRESHOLD
+#define DIRECTORYLISTER_PARALLEL_THRESHOLD 1000
+#endif
+
+// Maximum number of threads stat'ing entries in parallel.
+#ifndef DIRECTORYLISTER_STAT_THREADS
+#define DIRECTORYLISTER_STAT_THREADS 4
+#endif
+
+namespace {
+// Layout of the records returned by the getdents64 syscall.
+// glibc only provides a wrapper since version 2.30, so we call it directly.
+struct LinuxDirent64 {
+    quint64 d_ino;
+    qint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+const int direntBufferSize = 32*1024;
+const int checkpointInterval = 128; // entries
+const int statChunkSize = 128; // entries per parallel stat job
+
+struct StatResult {
+    struct stat lstatData;
+    struct stat statData;
+    bool exists;
+};
+
+// Returns false if the file vanished in the meantime.
+bool statEntry(int dirfd, const char* rawName, struct stat& lstatData, struct stat& statData)
+{
+    // check the file without following symlinks
+    if (fstatat(dirfd, rawName, &lstatData, AT_SYMLINK_NOFOLLOW) != 0) {
+        if (errno == ENOENT) return false; // removed while listing
+        memset(&lstatData, 0, sizeof(lstatData));
+    }
+
+    // check the file after following possible symlinks
+    if (S_ISLNK(lstatData.st_mode)) {
+        if (fstatat(dirfd, rawName, &statData, 0) != 0) {
+            memset(&statData, 0, sizeof(statData));
+        }
+    } else {
+        memcpy(&statData, &lstatData, sizeof(statData));
+    }
+
+    return true;
+}
+
+// Shared state of one parallel stat run. Helpers claim chunks of
+// entries in any order; the listing thread collects them in order.
+struct ParallelStatJob {
+    int dirfd;
+    const QVector<QByteArray>* rawNames;
+    StatResult* results;
+    int chunkCount;
+    QAtomicInt nextChunk = {0};
+    QAtomicInt stopped = {0};
+
+    QMutex mutex;
+    QWaitCondition changed;
+    QVector<bool> chunkDone; // guarded by mutex
+    int runningHelpers = {0}; // guarded by mutex
+};
+
+class ParallelStatHelper : public QRunnable
+{
+public:
+    explicit ParallelStatHelper(ParallelStatJob* job) : m_job(job) {
+        setAutoDelete(true);
+    }
+
+    void run() override {
+        while (m_job->stopped.loadAcquire() == 0) {
+            int chunk = m_job->nextChunk.fetchAndAddOrdered(1);
+            if (chunk >= m_job->chunkCount) break;
+
+            int first = chunk * statChunkSize;
+            int last = qMin(first + statChunkSize, m_job->rawNames->size());
+            for (int i = first; i < last; ++i) {
+                StatResult& result = m_job->results[i];
+                result.exists = statEntry(m_job->dirfd, m_job->rawNames->at(i).constData(),
+                                          result.lstatData, result.statData);
+            }
+
+            QMutexLocker locker(&m_job->mutex);
+            m_job->chunkDone[chunk] = true;
+            m_job->changed.wakeAll();
+        }
+
+        QMutexLocker locker(&m_job->mutex);
+        m_job->runningHelpers--;
+        m_job->changed.wakeAll();
+    }
+
+private:
+    ParallelStatJob* m_job;
+};
+
+QThreadPool* statThreadPool()
+{
+    // The pool is shared by all listers so the number of
+    // concurrent stat calls stays bounded.
+    static QThreadPool* pool = [](){
+        auto* p = new QThreadPool;
+        p->setMaxThreadCount(DIRECTORYLISTER_STAT_THREADS);
+        return p;
+    }();
+    return pool;
+}
+}
+
+DirectoryLister::DirectoryLister(QString directory) :
+    m_directory(directory)
+{
+}
+
+DirectoryLister::~DirectoryLister()
+{
+}
+
+bool DirectoryLister::list(EntryTable& entries,
+                           std::function<bool(const EntryTable&)> checkpoint)
+{
+    m_errorString = "";
+    entries = EntryTable(m_directory);
+    int dirfd = openDirectory();
+    if (dirfd < 0) return false;
+
+    // Names are read first because getdents64 is cheap compared to
+    // stat'ing, which has to wait for I/O on slow storage.
+    QVector<QByteArray> rawNames;
+    QVector<QString> names;
+    bool ok = readNames(dirfd, rawNames, names, entries, checkpoint);
+
+    if (ok) {
+        entries.reserve(names.size());
+        if (names.size() > DIRECTORYLISTER_PARALLEL_THRESHOLD) {
+            ok = statParallel(dirfd, rawNames, names, entries, checkpoint);
+        } else {
+            ok = statSequential(dirfd, rawNames, names, entries, checkpoint);
+        }
+    }
+
+    close(dirfd);
+    return ok;
+}
+
+bool DirectoryLister::listNames(const QStringList& names, EntryTable& entries)
+{
+    m_errorString = "";
+    entries = EntryTable(m_directory);
+    int dirfd = openDirectory();
+    if (dirfd < 0) return false;
+
+    struct stat lstatData;
+    struct stat statData;
+
+    for (const auto& name : names) {
+        if (!m_filter.accepts(name)) continue;
+        if (statEntry(dirfd, QFile::encodeName(name).constData(), lstatData, statData)) {
+            entries.append(name, lstatData, statData);
+        }
+    }
+
+    close(dirfd);
+    return true;
+}
+
+int DirectoryLister::openDirectory()
+{
+    QByteArray encodedDir = QFile::encodeName(m_directory);
+    int dirfd = open(encodedDir.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if (dirfd < 0) {
+        if (errno == EACCES) {
+            m_errorString = QCoreApplication::translate("FileModelWorker", "No permission to read the folder");
+        } else {
+            m_errorString = QCoreApplication::translate("FileModelWorker", "Folder does not exist");
+        }
+    }
+
+    return dirfd;
+}
+
+bool DirectoryLister::readNames(int dirfd, QVector<QByteArray>& rawNames, QVector<QString>& names,
+                                const EntryTable& entries,
+                                const std::function<bool(const EntryTable&)>& checkpoint)
+{
+    // the buffer must be suitably aligned for the dirent records
+    alignas(LinuxDirent64) char buffer[direntBufferSize];
+
+    while (true) {
+        long read = syscall(SYS_getdents64, dirfd, buffer, direntBufferSize);
+
+        if (read == 0) {
+            return true; // end of directory
+        } else if (read < 0) {
+            m_errorString = QString::fromLocal8Bit(strerror(errno));
+            return false;
+        }
+
+        for (long pos = 0; pos < read;) {
+            auto* dirent = reinterpret_cast<LinuxDirent64*>(buffer + pos);
+            pos += dirent->d_reclen;
+            const char* rawName = dirent->d_name;
+
+            // skip "." and ".."
+            if (rawName[0] == '.' && (rawName[1] == '\0' ||
+                                      (rawName[1] == '.' && rawName[2] == '\0'))) {
+                continue;
+            }
+
+            QString name = QFile::decodeName(rawName);
+            if (!m_filter.accepts(name)) continue;
+
+            rawNames.append(QByteArray(rawName));
+            names.append(name);
+        }
+
+        if (checkpoint && !checkpoint(entries)) return false;
+    }
+}
+
+bool DirectoryLister::statSequential(int dirfd, const QVector<QByteArray>& rawNames,
+                                     const QVector<QString>& names, EntryTable& entries,
+                                     const std::function<bool(const EntryTable&)>& checkpoint)
+{
+    struct stat lstatData;
+    struct stat statData;
+
+    for (int i = 0; i < rawNames.size(); ++i) {
+        if (statEntry(dirfd, rawNames.at(i).constData(), lstatData, statData)) {
+            entries.append(names.at(i), lstatData, statData);
+        }
+
+        if ((i+1) % checkpointInterval == 0 && checkpoint && !checkpoint(entries)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool DirectoryLister::statParallel(int dirfd, const QVector<QByteArray>& rawNames,
+                                   const QVector<QString>& names, EntryTable& entries,
+                                   const std::function<bool(const EntryTable&)>& checkpoint)
+{
+    QVector<StatResult> results(rawNames.size());
+
+    ParallelStatJob job;
+    job.dirfd = dirfd;
+    job.rawNames = &rawNames;
+    job.results = results.data();
+    job.chunkCount = (rawNames.size() + statChunkSize - 1) / statChunkSize;
+    job.chunkDone = QVector<bool>(job.chunkCount, false);
+
+    QThreadPool* pool = statThreadPool();
+    int helpers = qMin(pool->maxThreadCount(), job.chunkCount);
+    job.runningHelpers = helpers;
+    for (int i = 0; i < helpers; ++i) {
+        pool->start(new ParallelStatHelper(&job));
+    }
+
+    // Collect results in name order. Chunks finish in any order
+    // but entries are only appended once all earlier ones are known.
+    bool ok = true;
+    for (int chunk = 0; chunk < job.chunkCount; ++chunk) {
+        {
+            QMutexLocker locker(&job.mutex);
+            while (!job.chunkDone.at(chunk)) {
+                job.changed.wait(&job.mutex);
+            }
+        }
+
+        int first = chunk * statChunkSize;
+        int last = qMin(first + statChunkSize, rawNames.size());
+        for (int i = first; i < last; ++i) {
+            const StatResult& result = results.at(i);
+            if (!result.exists) continue;
+            entries.append(names.at(i), result.lstatData, result.statData);
+        }
+
+        if (checkpoint && !checkpoint(entries)) {
+            ok = false;
+            break;
+        }
+    }
+
+    // The job lives on our stack, so all helpers must be gone
+    // before returning, even if they never got to start.
+    job.stopped.storeRelease(1);
+    QMutexLocker locker(&job.mutex);
+    while (job.runningHelpers > 0) {
+        job.changed.wait(&job.mutex);
+    }
+
+    return ok;
+}
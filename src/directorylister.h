@@ -0,0 +1,83 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIRECTORYLISTER_H
+#define DIRECTORYLISTER_H
+
+#include <functional>
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <QStringList>
+#include "entrytable.h"
+#include "entryfilter.h"
+
+/**
+ * @brief The DirectoryLister class reads a directory in one pass.
+ *
+ * Entries are read using getdents64 on an open directory file descriptor
+ * and are stat'ed relative to that descriptor using fstatat. Entries that
+ * are rejected by the filter are dropped before they are stat'ed. Hidden
+ * files are not listed by default.
+ *
+ * Large directories are stat'ed by a bounded pool of threads. Results
+ * are still collected in the order in which the directory was read.
+ *
+ * The resulting list is not sorted.
+ */
+class DirectoryLister
+{
+public:
+    explicit DirectoryLister(QString directory);
+    ~DirectoryLister();
+
+    // see EntryFilter for how names are matched
+    void setHiddenShown(bool shown) { m_filter.setHiddenShown(shown); }
+    void setNameFilter(QString filter) { m_filter.setNameFilter(filter); }
+
+    // Returns false if listing failed or was cancelled. The checkpoint
+    // callback is called regularly with all entries read so far and
+    // cancels listing if it returns false. It may be empty.
+    bool list(EntryTable& entries,
+              std::function<bool(const EntryTable&)> checkpoint = {});
+    QString errorString() const { return m_errorString; }
+
+    // Stats only the entries with the given names. Names that do not
+    // exist anymore or that are filtered out are skipped.
+    bool listNames(const QStringList& names, EntryTable& entries);
+
+private:
+    int openDirectory();
+    bool readNames(int dirfd, QVector<QByteArray>& rawNames, QVector<QString>& names,
+                   const EntryTable& entries,
+                   const std::function<bool(const EntryTable&)>& checkpoint);
+    bool statSequential(int dirfd, const QVector<QByteArray>& rawNames,
+                        const QVector<QString>& names, EntryTable& entries,
+                        const std::function<bool(const EntryTable&)>& checkpoint);
+    bool statParallel(int dirfd, const QVector<QByteArray>& rawNames,
+                      const QVector<QString>& names, EntryTable& entries,
+                      const std::function<bool(const EntryTable&)>& checkpoint);
+
+    QString m_directory;
+    EntryFilter m_filter;
+    QString m_errorString = {""};
+};
+
+#endif // DIRECTORYLISTER_H
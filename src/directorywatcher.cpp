@@ -0,0 +1,124 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <QFile>
+#include <QSet>
+#include <QSocketNotifier>
+#include <QFileSystemWatcher>
+#include <QDebug>
+#include "directorywatcher.h"
+
+namespace {
+const uint32_t entryEvents = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                             IN_ATTRIB | IN_CLOSE_WRITE;
+const uint32_t selfEvents = IN_DELETE_SELF | IN_MOVE_SELF;
+const int eventBufferSize = 16*1024;
+}
+
+DirectoryWatcher::DirectoryWatcher(QObject *parent) : QObject(parent)
+{
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (m_inotifyFd >= 0) {
+        m_notifier = new QSocketNotifier(m_inotifyFd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this, &DirectoryWatcher::readEvents);
+    } else {
+        qDebug() << "[DirectoryWatcher] warning: inotify not available, using fallback";
+        m_fallback = new QFileSystemWatcher(this);
+        connect(m_fallback, &QFileSystemWatcher::directoryChanged,
+                this, &DirectoryWatcher::directoryChanged);
+    }
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    if (m_inotifyFd >= 0) {
+        delete m_notifier;
+        close(m_inotifyFd);
+    }
+}
+
+void DirectoryWatcher::setDirectory(const QString& path)
+{
+    if (path == m_directory) return;
+
+    if (m_fallback) {
+        if (!m_directory.isEmpty()) m_fallback->removePath(m_directory);
+        if (!path.isEmpty()) m_fallback->addPath(path);
+        m_directory = path;
+        return;
+    }
+
+    if (m_watchDescriptor >= 0) {
+        inotify_rm_watch(m_inotifyFd, m_watchDescriptor);
+        m_watchDescriptor = -1;
+    }
+
+    m_directory = path;
+    if (path.isEmpty()) return;
+
+    m_watchDescriptor = inotify_add_watch(m_inotifyFd, QFile::encodeName(path).constData(),
+                                          entryEvents | selfEvents | IN_ONLYDIR);
+    if (m_watchDescriptor < 0) {
+        qDebug() << "[DirectoryWatcher] error: cannot watch" << path << strerror(errno);
+    }
+}
+
+void DirectoryWatcher::readEvents()
+{
+    alignas(struct inotify_event) char buffer[eventBufferSize];
+    QSet<QString> names;
+    bool fullCompare = false;
+
+    while (true) {
+        ssize_t length = read(m_inotifyFd, buffer, eventBufferSize);
+        if (length <= 0) break; // EAGAIN: all events are read
+
+        for (ssize_t pos = 0; pos < length;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(buffer + pos);
+            pos += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // events were lost
+                fullCompare = true;
+                continue;
+            }
+
+            // events of a previous directory may still be queued
+            if (event->wd != m_watchDescriptor) continue;
+
+            if (event->mask & (selfEvents | IN_IGNORED)) {
+                fullCompare = true;
+            } else if (event->len > 0 && (event->mask & entryEvents)) {
+                names.insert(QFile::decodeName(event->name));
+            }
+        }
+    }
+
+    if (fullCompare) {
+        emit directoryChanged();
+    } else if (!names.isEmpty()) {
+        emit entriesChanged(names.toList());
+    }
+}
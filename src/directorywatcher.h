@@ -0,0 +1,71 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIRECTORYWATCHER_H
+#define DIRECTORYWATCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+class QSocketNotifier;
+class QFileSystemWatcher;
+
+/**
+ * @brief The DirectoryWatcher class reports which entries of a directory changed.
+ *
+ * It reads raw inotify events, so that only the entries that were created,
+ * removed, renamed, or modified have to be checked again. If the kernel
+ * event queue overflowed, or the directory itself was moved or removed,
+ * the watcher reports that the whole directory has to be compared.
+ *
+ * If inotify is not available, a QFileSystemWatcher is used instead,
+ * which can only report that something changed.
+ */
+class DirectoryWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DirectoryWatcher(QObject *parent = nullptr);
+    ~DirectoryWatcher();
+
+    // an empty path stops watching
+    void setDirectory(const QString& path);
+    QString directory() const { return m_directory; }
+
+signals:
+    // entries with these names were created, removed, or modified
+    void entriesChanged(QStringList names);
+    // changes are unknown, the directory has to be compared in full
+    void directoryChanged();
+
+private slots:
+    void readEvents();
+
+private:
+    QString m_directory;
+    int m_inotifyFd = {-1};
+    int m_watchDescriptor = {-1};
+    QSocketNotifier* m_notifier = {nullptr};
+    QFileSystemWatcher* m_fallback = {nullptr};
+};
+
+#endif // DIRECTORYWATCHER_H
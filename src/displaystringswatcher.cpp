@@ -0,0 +1,72 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QEvent>
+#include "displaystringswatcher.h"
+#include "entrytable.h"
+
+DisplayStringsWatcher* DisplayStringsWatcher::instance()
+{
+    // deleted together with the application, as it owns timers
+    static DisplayStringsWatcher* watcher = new DisplayStringsWatcher(qApp);
+    return watcher;
+}
+
+DisplayStringsWatcher::DisplayStringsWatcher(QObject *parent) : QObject(parent)
+{
+    m_dayChangeTimer.setSingleShot(true);
+    connect(&m_dayChangeTimer, &QTimer::timeout, this, &DisplayStringsWatcher::invalidate);
+    scheduleDayChange();
+
+    // The change is sent to the application and to every window,
+    // so all events of one change are handled together.
+    m_localeChangeTimer.setSingleShot(true);
+    m_localeChangeTimer.setInterval(0);
+    connect(&m_localeChangeTimer, &QTimer::timeout, this, &DisplayStringsWatcher::invalidate);
+    qApp->installEventFilter(this);
+}
+
+bool DisplayStringsWatcher::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::LocaleChange && !m_localeChangeTimer.isActive()) {
+        m_localeChangeTimer.start();
+    }
+
+    return QObject::eventFilter(watched, event);
+}
+
+void DisplayStringsWatcher::invalidate()
+{
+    EntryTable::invalidateDisplayStrings();
+    emit invalidated();
+    scheduleDayChange();
+}
+
+void DisplayStringsWatcher::scheduleDayChange()
+{
+    // shortly after the next midnight
+    QDateTime now = QDateTime::currentDateTime();
+    QDateTime midnight(now.date().addDays(1), QTime(0, 0));
+    m_dayChangeTimer.start(int(qBound(Q_INT64_C(1000), now.msecsTo(midnight) + 1000,
+                                      Q_INT64_C(24*60*60*1000))));
+}
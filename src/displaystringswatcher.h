@@ -0,0 +1,61 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DISPLAYSTRINGSWATCHER_H
+#define DISPLAYSTRINGSWATCHER_H
+
+#include <QObject>
+#include <QTimer>
+
+/**
+ * @brief The DisplayStringsWatcher class tells when display strings are outdated.
+ *
+ * Sizes and dates are formatted for the current locale, and dates of today
+ * are shown differently. When the locale changes or a new day begins, the
+ * watcher invalidates the display strings of all EntryTable instances once
+ * and then emits invalidated(), so that models can update their entries.
+ * It is shared by all models and must only be used from the main thread.
+ */
+class DisplayStringsWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    static DisplayStringsWatcher* instance();
+
+signals:
+    void invalidated();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void invalidate();
+
+private:
+    explicit DisplayStringsWatcher(QObject *parent = nullptr);
+    void scheduleDayChange();
+
+    QTimer m_dayChangeTimer;
+    QTimer m_localeChangeTimer;
+};
+
+#endif // DISPLAYSTRINGSWATCHER_H
@@ -0,0 +1,87 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <QDir>
+#include "doomedregistry.h"
+
+DoomedRegistry* DoomedRegistry::instance()
+{
+    static DoomedRegistry registry;
+    return &registry;
+}
+
+DoomedRegistry::DoomedRegistry(QObject *parent) : QObject(parent)
+{
+}
+
+void DoomedRegistry::splitPath(const QString& path, QString& directory, QString& name)
+{
+    // same form as EntryTable::absoluteFilePath()
+    QString cleanPath = QDir::cleanPath(path);
+    int lastSlash = cleanPath.lastIndexOf('/');
+    directory = cleanPath.left(lastSlash + 1);
+    name = cleanPath.mid(lastSlash + 1);
+}
+
+void DoomedRegistry::add(const QStringList& absolutePaths)
+{
+    QSet<QString> changedDirectories;
+    QString directory, name;
+
+    for (const auto& path : absolutePaths) {
+        splitPath(path, directory, name);
+        if (name.isEmpty()) continue;
+        m_paths[directory].insert(name);
+        changedDirectories.insert(directory);
+    }
+
+    for (const auto& dir : changedDirectories) {
+        emit changed(dir);
+    }
+}
+
+void DoomedRegistry::release(const QStringList& absolutePaths)
+{
+    QSet<QString> changedDirectories;
+    QString directory, name;
+
+    for (const auto& path : absolutePaths) {
+        splitPath(path, directory, name);
+        auto it = m_paths.find(directory);
+        if (it == m_paths.end() || !it->remove(name)) continue;
+        if (it->isEmpty()) m_paths.erase(it);
+        changedDirectories.insert(directory);
+    }
+
+    for (const auto& dir : changedDirectories) {
+        emit changed(dir);
+    }
+}
+
+void DoomedRegistry::releaseAll()
+{
+    QList<QString> directories = m_paths.keys();
+    m_paths.clear();
+
+    for (const auto& dir : directories) {
+        emit changed(dir);
+    }
+}
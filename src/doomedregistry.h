@@ -0,0 +1,72 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DOOMEDREGISTRY_H
+#define DOOMEDREGISTRY_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+
+/**
+ * @brief The DoomedRegistry class keeps the paths of files that will be gone soon.
+ *
+ * Files are doomed while they are being deleted or moved away. The registry
+ * is shared by all models, so doomed files stay marked when a folder is
+ * refreshed or opened again. Paths are grouped by their directory, so that
+ * a model can check its entries with one lookup per entry.
+ *
+ * Paths are released when they were deleted, when the file operation failed,
+ * or when a listing of their directory does not contain them anymore.
+ * The registry must only be used from the main thread.
+ */
+class DoomedRegistry : public QObject
+{
+    Q_OBJECT
+
+public:
+    static DoomedRegistry* instance();
+
+    void add(const QStringList& absolutePaths);
+    void release(const QStringList& absolutePaths);
+    void releaseAll();
+
+    // 'directory' must end with a slash, as in EntryTable::directoryPrefix()
+    QSet<QString> names(const QString& directory) const { return m_paths.value(directory); }
+    bool isEmpty() const { return m_paths.isEmpty(); }
+
+public slots:
+    void releasePath(QString absolutePath) { release({absolutePath}); }
+
+signals:
+    // entries in this directory were added or released
+    void changed(QString directory);
+
+private:
+    explicit DoomedRegistry(QObject *parent = nullptr);
+    static void splitPath(const QString& path, QString& directory, QString& name);
+
+    QHash<QString, QSet<QString>> m_paths; // names by directory
+};
+
+#endif // DOOMEDREGISTRY_H
@@ -26,6 +26,7 @@
 #include <QSettings>
 #include <QStandardPaths>
 #include <QDir>
+#include <QFileInfo>
 #include <QCoreApplication>
 #include <QProcess>
 #include <unistd.h>
@@ -33,6 +34,8 @@
 #include "fileworker.h"
 #include "statfileinfo.h"
 #include "settingshandler.h"
+#include "doomedregistry.h"
+#include "transferjournal.h"
 
 Engine::Engine(QObject *parent) :
     QObject(parent),
@@ -43,21 +46,31 @@ Engine::Engine(QObject *parent) :
 {
     m_fileWorker = new FileWorker;
     m_settings = qApp->property("settings").value<Settings*>();
+    m_interruptedTransfer = TransferJournal::exists();
 
     // update progress property when worker progresses
     connect(m_fileWorker, SIGNAL(progressChanged(int, QString)),
             this, SLOT(setProgress(int, QString)));
+    connect(m_fileWorker, &FileWorker::transferProgressChanged, this, &Engine::setTransferProgress);
+    connect(m_fileWorker, &FileWorker::transferPlanned, this, &Engine::setTransferPlan);
 
     // pass worker end signals to QML
     connect(m_fileWorker, SIGNAL(done()), this, SIGNAL(workerDone()));
     connect(m_fileWorker, SIGNAL(errorOccurred(QString, QString)),
             this, SIGNAL(workerErrorOccurred(QString, QString)));
     connect(m_fileWorker, SIGNAL(fileDeleted(QString)), this, SIGNAL(fileDeleted(QString)));
+    connect(m_fileWorker, &FileWorker::finished, this, [this](){ setPaused(false); });
+
+    // files that were deleted or could not be touched are not doomed anymore
+    connect(m_fileWorker, &FileWorker::fileDeleted, DoomedRegistry::instance(), &DoomedRegistry::releasePath);
+    connect(m_fileWorker, &FileWorker::errorOccurred, DoomedRegistry::instance(), [](){
+        DoomedRegistry::instance()->releaseAll();
+    });
 }
 
 Engine::~Engine()
 {
-    m_fileWorker->cancel(); // ask the background thread to exit its loop
+    m_fileWorker->interrupt(); // ask the background thread to exit its loop, keeping its journal
     // is this the way to force stop the worker thread?
     m_fileWorker->wait();   // wait until thread stops
     m_fileWorker->deleteLater();    // delete it
@@ -133,6 +146,7 @@ void Engine::pasteFiles(QString destDirectory, bool asSymlinks)
     }
 
     setProgress(0, "");
+    setTransferPlan(QVariantMap());
 
     QDir dest(destDirectory);
     if (!dest.exists()) {
@@ -162,6 +176,9 @@ void Engine::pasteFiles(QString destDirectory, bool asSymlinks)
     m_clipboardFiles.clear();
     emit clipboardCountChanged();
 
+    // the journal is replaced by the new transfer
+    if (!asSymlinks) discardInterruptedTransfer();
+
     if (asSymlinks) {
         m_fileWorker->startSymlinkFiles(files, destDirectory);
     } else if (m_clipboardContainsCopy) {
@@ -176,6 +193,38 @@ void Engine::cancel()
     m_fileWorker->cancel();
 }
 
+void Engine::resumeInterruptedTransfer()
+{
+    if (!m_interruptedTransfer) return;
+    m_interruptedTransfer = false;
+    emit interruptedTransferChanged();
+
+    setProgress(0, "");
+    setTransferPlan(QVariantMap());
+    m_fileWorker->startResumeTransfer();
+}
+
+void Engine::discardInterruptedTransfer()
+{
+    if (!m_interruptedTransfer) return;
+    m_interruptedTransfer = false;
+    emit interruptedTransferChanged();
+    TransferJournal::remove();
+}
+
+void Engine::pause()
+{
+    if (!m_fileWorker->isRunning()) return;
+    m_fileWorker->pause();
+    setPaused(true);
+}
+
+void Engine::resume()
+{
+    m_fileWorker->resume();
+    setPaused(false);
+}
+
 static QStringList subdirs(const QString &dirname, bool includeHidden = false)
 {
     QDir dir(dirname);
@@ -520,6 +569,32 @@ void Engine::setProgress(int progress, QString filename)
     emit progressFilenameChanged();
 }
 
+void Engine::setTransferProgress(qint64 bytesDone, qint64 bytesTotal,
+                                 qint64 bytesPerSecond, qint64 secondsRemaining,
+                                 int filesDone, int filesPerSecond)
+{
+    m_bytesDone = bytesDone;
+    m_bytesTotal = bytesTotal;
+    m_bytesPerSecond = bytesPerSecond;
+    m_secondsRemaining = secondsRemaining;
+    m_filesDone = filesDone;
+    m_filesPerSecond = filesPerSecond;
+    emit transferProgressChanged();
+}
+
+void Engine::setTransferPlan(QVariantMap plan)
+{
+    m_transferPlan = plan;
+    emit transferPlanChanged();
+}
+
+void Engine::setPaused(bool paused)
+{
+    if (m_paused == paused) return;
+    m_paused = paused;
+    emit pausedChanged();
+}
+
 QMap<QString, QString> Engine::mountPoints() const
 {
     // read /proc/mounts and return all mount points for the filesystem
@@ -38,6 +38,15 @@ class Engine : public QObject
     Q_PROPERTY(int clipboardContainsCopy READ clipboardContainsCopy() NOTIFY clipboardContainsCopyChanged())
     Q_PROPERTY(int progress READ progress() NOTIFY progressChanged())
     Q_PROPERTY(QString progressFilename READ progressFilename() NOTIFY progressFilenameChanged())
+    Q_PROPERTY(qint64 bytesDone READ bytesDone() NOTIFY transferProgressChanged())
+    Q_PROPERTY(qint64 bytesTotal READ bytesTotal() NOTIFY transferProgressChanged())
+    Q_PROPERTY(qint64 bytesPerSecond READ bytesPerSecond() NOTIFY transferProgressChanged())
+    Q_PROPERTY(qint64 secondsRemaining READ secondsRemaining() NOTIFY transferProgressChanged())
+    Q_PROPERTY(int filesDone READ filesDone() NOTIFY transferProgressChanged())
+    Q_PROPERTY(int filesPerSecond READ filesPerSecond() NOTIFY transferProgressChanged())
+    Q_PROPERTY(bool paused READ paused() NOTIFY pausedChanged())
+    Q_PROPERTY(QVariantMap transferPlan READ transferPlan() NOTIFY transferPlanChanged())
+    Q_PROPERTY(bool interruptedTransfer READ interruptedTransfer() NOTIFY interruptedTransferChanged())
 
 public:
     explicit Engine(QObject *parent = nullptr);
@@ -48,6 +57,15 @@ public:
     bool clipboardContainsCopy() const { return m_clipboardContainsCopy; }
     int progress() const { return m_progress; }
     QString progressFilename() const { return m_progressFilename; }
+    qint64 bytesDone() const { return m_bytesDone; }
+    qint64 bytesTotal() const { return m_bytesTotal; }
+    qint64 bytesPerSecond() const { return m_bytesPerSecond; }
+    qint64 secondsRemaining() const { return m_secondsRemaining; }
+    int filesDone() const { return m_filesDone; }
+    int filesPerSecond() const { return m_filesPerSecond; }
+    bool paused() const { return m_paused; }
+    QVariantMap transferPlan() const { return m_transferPlan; }
+    bool interruptedTransfer() const { return m_interruptedTransfer; }
 
     // methods accessible from QML
 
@@ -63,6 +81,14 @@ public:
     // cancel asynch methods
     Q_INVOKABLE void cancel();
 
+    // pause and resume copying files
+    Q_INVOKABLE void pause();
+    Q_INVOKABLE void resume();
+
+    // continue or forget a transfer that was interrupted when the app was closed
+    Q_INVOKABLE void resumeInterruptedTransfer();
+    Q_INVOKABLE void discardInterruptedTransfer();
+
     // returns error msg
     Q_INVOKABLE QString errorMessage() const { return m_errorMessage; }
 
@@ -92,12 +118,21 @@ signals:
     void clipboardContainsCopyChanged();
     void progressChanged();
     void progressFilenameChanged();
+    void transferProgressChanged();
+    void pausedChanged();
+    void transferPlanChanged();
+    void interruptedTransferChanged();
     void workerDone();
     void workerErrorOccurred(QString message, QString filename);
     void fileDeleted(QString fullname);
 
 private slots:
     void setProgress(int progress, QString filename);
+    void setTransferProgress(qint64 bytesDone, qint64 bytesTotal,
+                             qint64 bytesPerSecond, qint64 secondsRemaining,
+                             int filesDone, int filesPerSecond);
+    void setPaused(bool paused);
+    void setTransferPlan(QVariantMap plan);
 
 private:
     QMap<QString, QString> mountPoints() const;
@@ -110,6 +145,15 @@ private:
     bool m_clipboardContainsCopy;
     int m_progress;
     QString m_progressFilename;
+    qint64 m_bytesDone = {0};
+    qint64 m_bytesTotal = {-1};
+    qint64 m_bytesPerSecond = {0};
+    qint64 m_secondsRemaining = {-1};
+    int m_filesDone = {0};
+    int m_filesPerSecond = {0};
+    bool m_paused = {false};
+    QVariantMap m_transferPlan;
+    bool m_interruptedTransfer = {false};
     QString m_errorMessage;
     FileWorker* m_fileWorker;
 
@@ -0,0 +1,230 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <QHash>
+#include "entrydiff.h"
+
+namespace {
+// Marks the longest strictly increasing subsequence of 'values'.
+// These entries keep their place, all others have to be moved.
+QVector<bool> longestIncreasingSubsequence(const QVector<int>& values)
+{
+    QVector<int> tails; // tails[l]: last position of the best subsequence of length l+1
+    QVector<int> previous(values.count(), -1);
+
+    for (int i = 0; i < values.count(); ++i) {
+        int low = 0;
+        int high = tails.count();
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (values.at(tails.at(mid)) < values.at(i)) low = mid + 1;
+            else high = mid;
+        }
+
+        if (low > 0) previous[i] = tails.at(low - 1);
+        if (low == tails.count()) tails.append(i);
+        else tails[low] = i;
+    }
+
+    QVector<bool> result(values.count(), false);
+    for (int i = tails.isEmpty() ? -1 : tails.last(); i >= 0; i = previous.at(i)) {
+        result[i] = true;
+    }
+    return result;
+}
+
+struct MoveRun {
+    int first; // rank of the first entry
+    int count;
+};
+}
+
+EntryDiff::EntryDiff()
+{
+}
+
+EntryDiff EntryDiff::compute(const EntryTable& oldEntries, const EntryTable& newEntries,
+                             int maxOperations)
+{
+    EntryDiff diff;
+    diff.m_oldCount = oldEntries.count();
+    diff.m_newCount = newEntries.count();
+
+    const int oldCount = oldEntries.count();
+    const int newCount = newEntries.count();
+    QVector<int> oldToNew(oldCount, -1);
+    QVector<int> newToOld(newCount, -1);
+
+    // match entries by name
+    // The stored name hashes are used so no string has to be hashed again.
+    QMultiHash<uint, int> newByName;
+    newByName.reserve(newCount);
+    for (int j = 0; j < newCount; ++j) {
+        newByName.insert(newEntries.nameHash(j), j);
+    }
+
+    for (int i = 0; i < oldCount; ++i) {
+        const uint hash = oldEntries.nameHash(i);
+        for (auto it = newByName.constFind(hash); it != newByName.constEnd() && it.key() == hash; ++it) {
+            if (newEntries.name(it.value()) == oldEntries.name(i)) {
+                oldToNew[i] = it.value();
+                newToOld[it.value()] = i;
+                break;
+            }
+        }
+    }
+
+    // match renamed entries by inode
+    QHash<quint64, int> unmatchedByInode;
+    for (int j = 0; j < newCount; ++j) {
+        if (newToOld.at(j) < 0 && newEntries.inode(j) != 0) {
+            unmatchedByInode.insert(newEntries.inode(j), j);
+        }
+    }
+
+    if (!unmatchedByInode.isEmpty()) {
+        for (int i = 0; i < oldCount; ++i) {
+            if (oldToNew.at(i) >= 0) continue;
+            int j = unmatchedByInode.value(oldEntries.inode(i), -1);
+            if (j >= 0 && newToOld.at(j) < 0) {
+                oldToNew[i] = j;
+                newToOld[j] = i;
+                diff.m_renamedRows++;
+            }
+        }
+    }
+
+    // 1. remove old entries from the bottom up
+    for (int i = oldCount - 1; i >= 0;) {
+        if (oldToNew.at(i) >= 0) { --i; continue; }
+        int last = i;
+        while (i >= 0 && oldToNew.at(i) < 0) --i;
+        diff.addOperation(Operation::Remove, i + 1, last - i, -1);
+        diff.m_removedRows += last - i;
+    }
+
+    // 2. move remaining entries into their new order
+    // Entries are identified by their rank among all matched entries
+    // in the new listing. Entries on the longest increasing subsequence
+    // stay in place, all others are moved in runs of adjacent ranks.
+    QVector<int> rankOfNew(newCount, -1);
+    int matchedCount = 0;
+    for (int j = 0; j < newCount; ++j) {
+        if (newToOld.at(j) >= 0) rankOfNew[j] = matchedCount++;
+    }
+
+    QVector<int> current;
+    current.reserve(matchedCount);
+    for (int i = 0; i < oldCount; ++i) {
+        if (oldToNew.at(i) >= 0) current.append(rankOfNew.at(oldToNew.at(i)));
+    }
+
+    QVector<bool> stays = longestIncreasingSubsequence(current);
+    QVector<bool> placed(matchedCount, false);
+    QVector<MoveRun> runs;
+
+    for (int p = 0; p < current.count();) {
+        if (stays.at(p)) {
+            placed[current.at(p)] = true;
+            ++p;
+            continue;
+        }
+
+        MoveRun run = {current.at(p), 1};
+        ++p;
+        while (p < current.count() && !stays.at(p) && current.at(p) == run.first + run.count) {
+            run.count++;
+            ++p;
+        }
+        runs.append(run);
+    }
+
+    if (diff.m_operations.count() + runs.count() > maxOperations) {
+        diff.m_valid = false;
+        return diff;
+    }
+
+    std::sort(runs.begin(), runs.end(), [](const MoveRun& a, const MoveRun& b){
+        return a.first < b.first;
+    });
+
+    for (const auto& run : runs) {
+        int from = current.indexOf(run.first);
+        current.remove(from, run.count);
+
+        // place the run right behind the closest entry already in order
+        int previous = run.first - 1;
+        while (previous >= 0 && !placed.at(previous)) --previous;
+        int to = (previous < 0) ? 0 : current.indexOf(previous) + 1;
+
+        current.insert(to, run.count, 0);
+        for (int k = 0; k < run.count; ++k) {
+            current[to + k] = run.first + k;
+            placed[run.first + k] = true;
+        }
+
+        if (to != from) {
+            diff.addOperation(Operation::Move, from, run.count, to < from ? to : to + run.count);
+            diff.m_movedRows += run.count;
+        }
+    }
+
+    // 3. insert new entries from the top down
+    for (int j = 0; j < newCount;) {
+        if (newToOld.at(j) >= 0) { ++j; continue; }
+        int first = j;
+        while (j < newCount && newToOld.at(j) < 0) ++j;
+        diff.addOperation(Operation::Insert, first, j - first, first);
+        diff.m_insertedRows += j - first;
+    }
+
+    // 4. update entries whose metadata changed
+    for (int j = 0; j < newCount;) {
+        int i = newToOld.at(j);
+        if (i < 0 || oldEntries.fingerprint(i) == newEntries.fingerprint(j)) { ++j; continue; }
+
+        int first = j;
+        ++j;
+        while (j < newCount) {
+            i = newToOld.at(j);
+            if (i < 0 || oldEntries.fingerprint(i) == newEntries.fingerprint(j)) break;
+            ++j;
+        }
+        diff.addOperation(Operation::Change, first, j - first, first);
+        diff.m_changedRows += j - first;
+    }
+
+    if (diff.m_operations.count() > maxOperations) {
+        diff.m_valid = false;
+    }
+
+    return diff;
+}
+
+void EntryDiff::addOperation(Operation::Type type, int first, int count, int target)
+{
+    Operation op;
+    op.type = type;
+    op.first = first;
+    op.count = count;
+    op.target = target;
+    m_operations.append(op);
+}
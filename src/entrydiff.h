@@ -0,0 +1,91 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENTRYDIFF_H
+#define ENTRYDIFF_H
+
+#include <QVector>
+#include "entrytable.h"
+
+/**
+ * @brief The EntryDiff class describes how to turn one sorted listing into another.
+ *
+ * Entries are matched by name, and entries that were renamed are matched
+ * by their inode. Changes are collected as ranges of rows so that a model
+ * can apply them with one insert, remove, or move notification per range.
+ *
+ * Operations must be applied in order. Row numbers always refer to the
+ * list as it is after all previous operations have been applied:
+ * first all removals (bottom to top), then all moves, then all insertions
+ * (top to bottom), and finally all changed rows.
+ */
+class EntryDiff
+{
+public:
+    struct Operation {
+        enum Type : quint8 {
+            Remove, Move, Insert, Change
+        };
+
+        Type type;
+        int first; // first affected row
+        int count;
+
+        // Move: row before which the rows are placed, as for beginMoveRows()
+        // Insert, Change: first row in the new listing to copy data from
+        int target;
+    };
+
+    explicit EntryDiff();
+
+    // Returns an invalid diff if more than 'maxOperations' ranges
+    // would be needed. Use a full refresh in this case.
+    static EntryDiff compute(const EntryTable& oldEntries, const EntryTable& newEntries,
+                             int maxOperations);
+
+    bool isValid() const { return m_valid; }
+    bool isEmpty() const { return m_operations.isEmpty(); }
+    const QVector<Operation>& operations() const { return m_operations; }
+
+    int oldCount() const { return m_oldCount; }
+    int newCount() const { return m_newCount; }
+
+    // statistics for logging
+    int removedRows() const { return m_removedRows; }
+    int insertedRows() const { return m_insertedRows; }
+    int movedRows() const { return m_movedRows; }
+    int changedRows() const { return m_changedRows; }
+    int renamedRows() const { return m_renamedRows; }
+
+private:
+    void addOperation(Operation::Type type, int first, int count, int target);
+
+    QVector<Operation> m_operations;
+    bool m_valid = {true};
+    int m_oldCount = {0};
+    int m_newCount = {0};
+    int m_removedRows = {0};
+    int m_insertedRows = {0};
+    int m_movedRows = {0};
+    int m_changedRows = {0};
+    int m_renamedRows = {0};
+};
+
+#endif // ENTRYDIFF_H
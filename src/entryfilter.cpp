@@ -0,0 +1,47 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "entryfilter.h"
+
+EntryFilter::EntryFilter()
+{
+}
+
+void EntryFilter::setNameFilter(QString filter)
+{
+    m_nameFilter = filter;
+    m_nameFilterIsWildcard = filter.contains('*') || filter.contains('?') || filter.contains('[');
+
+    if (m_nameFilterIsWildcard) {
+        // same semantics as QDir's name filters, which we used before
+        m_nameFilterRegExp = QRegExp("*"+filter+"*", Qt::CaseInsensitive, QRegExp::Wildcard);
+    } else {
+        m_nameFilterRegExp = QRegExp();
+    }
+}
+
+bool EntryFilter::accepts(const QString& name) const
+{
+    if (!m_hiddenShown && name.startsWith('.')) return false;
+    if (m_nameFilter.isEmpty()) return true;
+    if (m_nameFilterIsWildcard) return m_nameFilterRegExp.exactMatch(name);
+    return name.contains(m_nameFilter, Qt::CaseInsensitive);
+}
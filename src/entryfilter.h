@@ -0,0 +1,54 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ENTRYFILTER_H
+#define ENTRYFILTER_H
+
+#include <QString>
+#include <QRegExp>
+
+/**
+ * @brief The EntryFilter class decides which entries of a listing are shown.
+ *
+ * Hidden files are dropped unless they are shown. The name filter is
+ * matched case-insensitively against the whole name. Wildcards are
+ * supported; without wildcards the filter matches all names that
+ * contain it. An empty filter matches everything.
+ */
+class EntryFilter
+{
+public:
+    explicit EntryFilter();
+
+    void setHiddenShown(bool shown) { m_hiddenShown = shown; }
+    void setNameFilter(QString filter);
+
+    bool accepts(const QString& name) const;
+    bool acceptsAll() const { return m_hiddenShown && m_nameFilter.isEmpty(); }
+
+private:
+    bool m_hiddenShown = {false};
+    QString m_nameFilter = {""};
+    QRegExp m_nameFilterRegExp;
+    bool m_nameFilterIsWildcard = {false};
+};
+
+#endif // ENTRYFILTER_H
@@ -0,0 +1,434 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <QDir>
+#include <QHash>
+#include "entrytable.h"
+#include "globals.h"
+
+QAtomicInt EntryTable::s_displayGeneration = {1};
+
+EntryTable::EntryTable() :
+    m_prefix("")
+{
+}
+
+EntryTable::EntryTable(const QString& directory)
+{
+    m_prefix = QDir(directory).absolutePath();
+    if (!m_prefix.endsWith('/')) m_prefix.append('/');
+}
+
+void EntryTable::reserve(int size)
+{
+    m_names.reserve(size);
+    m_nameHashes.reserve(size);
+    m_modes.reserve(size);
+    m_sizes.reserve(size);
+    m_modTimes.reserve(size);
+    m_inodes.reserve(size);
+    m_devices.reserve(size);
+    m_targetInodes.reserve(size);
+    m_linkCounts.reserve(size);
+    m_ownership.reserve(size);
+    m_display.reserve(size);
+    m_flags.reserve(size);
+}
+
+void EntryTable::clear()
+{
+    m_names.clear();
+    m_nameHashes.clear();
+    m_modes.clear();
+    m_sizes.clear();
+    m_modTimes.clear();
+    m_inodes.clear();
+    m_devices.clear();
+    m_targetInodes.clear();
+    m_linkCounts.clear();
+    m_ownership.clear();
+    m_display.clear();
+    m_flags.clear();
+    m_selectedCount = 0;
+}
+
+void EntryTable::clearFlags()
+{
+    m_flags.fill(NoFlags);
+    m_selectedCount = 0;
+}
+
+void EntryTable::append(const QString& name, const struct stat& lstatData, const struct stat& statData)
+{
+    m_names.append(name);
+    m_nameHashes.append(qHash(name));
+    m_modes.append((quint32(lstatData.st_mode) & 0xFFFF) | ((quint32(statData.st_mode) & 0xFFFF) << 16));
+    m_sizes.append(statData.st_size);
+    m_modTimes.append(qint64(statData.st_mtim.tv_sec) * 1000000000LL + statData.st_mtim.tv_nsec);
+    m_inodes.append(lstatData.st_ino);
+    m_devices.append(quint64(statData.st_dev));
+    m_targetInodes.append(quint64(statData.st_ino));
+    m_linkCounts.append(quint32(statData.st_nlink));
+    m_ownership.append((quint64(statData.st_uid) << 32) | quint32(statData.st_gid));
+    m_display.append(DisplayStrings());
+    m_flags.append(NoFlags);
+}
+
+void EntryTable::appendRow(const EntryTable& other, int row)
+{
+    m_names.append(other.m_names.at(row));
+    m_nameHashes.append(other.m_nameHashes.at(row));
+    m_modes.append(other.m_modes.at(row));
+    m_sizes.append(other.m_sizes.at(row));
+    m_modTimes.append(other.m_modTimes.at(row));
+    m_inodes.append(other.m_inodes.at(row));
+    m_devices.append(other.m_devices.at(row));
+    m_targetInodes.append(other.m_targetInodes.at(row));
+    m_linkCounts.append(other.m_linkCounts.at(row));
+    m_ownership.append(other.m_ownership.at(row));
+    m_display.append(other.m_display.at(row));
+    m_flags.append(other.m_flags.at(row));
+    if (other.isSelected(row)) m_selectedCount++;
+}
+
+void EntryTable::appendRows(const EntryTable& other)
+{
+    m_names += other.m_names;
+    m_nameHashes += other.m_nameHashes;
+    m_modes += other.m_modes;
+    m_sizes += other.m_sizes;
+    m_modTimes += other.m_modTimes;
+    m_inodes += other.m_inodes;
+    m_devices += other.m_devices;
+    m_targetInodes += other.m_targetInodes;
+    m_linkCounts += other.m_linkCounts;
+    m_ownership += other.m_ownership;
+    m_display += other.m_display;
+    m_flags += other.m_flags;
+    m_selectedCount += other.m_selectedCount;
+}
+
+void EntryTable::insertRow(int at, const EntryTable& other, int row)
+{
+    m_names.insert(at, other.m_names.at(row));
+    m_nameHashes.insert(at, other.m_nameHashes.at(row));
+    m_modes.insert(at, other.m_modes.at(row));
+    m_sizes.insert(at, other.m_sizes.at(row));
+    m_modTimes.insert(at, other.m_modTimes.at(row));
+    m_inodes.insert(at, other.m_inodes.at(row));
+    m_devices.insert(at, other.m_devices.at(row));
+    m_targetInodes.insert(at, other.m_targetInodes.at(row));
+    m_linkCounts.insert(at, other.m_linkCounts.at(row));
+    m_ownership.insert(at, other.m_ownership.at(row));
+    m_display.insert(at, other.m_display.at(row));
+    m_flags.insert(at, other.m_flags.at(row));
+    if (other.isSelected(row)) m_selectedCount++;
+}
+
+namespace {
+template<typename T>
+void insertColumnRange(QVector<T>& column, int at, const QVector<T>& source, int first, int count)
+{
+    column.insert(at, count, T());
+    std::copy(source.constBegin() + first, source.constBegin() + first + count, column.begin() + at);
+}
+
+template<typename T>
+void moveColumnRange(QVector<T>& column, int first, int count, int destination)
+{
+    // destination is the row before which the range is placed
+    auto begin = column.begin();
+    if (destination < first) {
+        std::rotate(begin + destination, begin + first, begin + first + count);
+    } else {
+        std::rotate(begin + first, begin + first + count, begin + destination);
+    }
+}
+}
+
+void EntryTable::insertRows(int at, const EntryTable& other, int first, int count)
+{
+    insertColumnRange(m_names, at, other.m_names, first, count);
+    insertColumnRange(m_nameHashes, at, other.m_nameHashes, first, count);
+    insertColumnRange(m_modes, at, other.m_modes, first, count);
+    insertColumnRange(m_sizes, at, other.m_sizes, first, count);
+    insertColumnRange(m_modTimes, at, other.m_modTimes, first, count);
+    insertColumnRange(m_inodes, at, other.m_inodes, first, count);
+    insertColumnRange(m_devices, at, other.m_devices, first, count);
+    insertColumnRange(m_targetInodes, at, other.m_targetInodes, first, count);
+    insertColumnRange(m_linkCounts, at, other.m_linkCounts, first, count);
+    insertColumnRange(m_ownership, at, other.m_ownership, first, count);
+    insertColumnRange(m_display, at, other.m_display, first, count);
+    insertColumnRange(m_flags, at, other.m_flags, first, count);
+    m_selectedCount += other.countSelected(first, count);
+}
+
+void EntryTable::removeRow(int row)
+{
+    removeRows(row, 1);
+}
+
+void EntryTable::removeRows(int first, int count)
+{
+    m_selectedCount -= countSelected(first, count);
+    m_names.remove(first, count);
+    m_nameHashes.remove(first, count);
+    m_modes.remove(first, count);
+    m_sizes.remove(first, count);
+    m_modTimes.remove(first, count);
+    m_inodes.remove(first, count);
+    m_devices.remove(first, count);
+    m_targetInodes.remove(first, count);
+    m_linkCounts.remove(first, count);
+    m_ownership.remove(first, count);
+    m_display.remove(first, count);
+    m_flags.remove(first, count);
+}
+
+void EntryTable::moveRows(int first, int count, int destination)
+{
+    if (destination >= first && destination <= first + count) return; // no-op
+    moveColumnRange(m_names, first, count, destination);
+    moveColumnRange(m_nameHashes, first, count, destination);
+    moveColumnRange(m_modes, first, count, destination);
+    moveColumnRange(m_sizes, first, count, destination);
+    moveColumnRange(m_modTimes, first, count, destination);
+    moveColumnRange(m_inodes, first, count, destination);
+    moveColumnRange(m_devices, first, count, destination);
+    moveColumnRange(m_targetInodes, first, count, destination);
+    moveColumnRange(m_linkCounts, first, count, destination);
+    moveColumnRange(m_ownership, first, count, destination);
+    moveColumnRange(m_display, first, count, destination);
+    moveColumnRange(m_flags, first, count, destination);
+}
+
+void EntryTable::replaceRow(int row, const EntryTable& other, int otherRow)
+{
+    m_names[row] = other.m_names.at(otherRow);
+    m_nameHashes[row] = other.m_nameHashes.at(otherRow);
+    m_modes[row] = other.m_modes.at(otherRow);
+    m_sizes[row] = other.m_sizes.at(otherRow);
+    m_modTimes[row] = other.m_modTimes.at(otherRow);
+    m_inodes[row] = other.m_inodes.at(otherRow);
+    m_devices[row] = other.m_devices.at(otherRow);
+    m_targetInodes[row] = other.m_targetInodes.at(otherRow);
+    m_linkCounts[row] = other.m_linkCounts.at(otherRow);
+    m_ownership[row] = other.m_ownership.at(otherRow);
+    m_display[row] = other.m_display.at(otherRow);
+}
+
+EntryTable EntryTable::mid(int first, int length) const
+{
+    EntryTable result;
+    result.m_prefix = m_prefix;
+    result.m_names = m_names.mid(first, length);
+    result.m_nameHashes = m_nameHashes.mid(first, length);
+    result.m_modes = m_modes.mid(first, length);
+    result.m_sizes = m_sizes.mid(first, length);
+    result.m_modTimes = m_modTimes.mid(first, length);
+    result.m_inodes = m_inodes.mid(first, length);
+    result.m_devices = m_devices.mid(first, length);
+    result.m_targetInodes = m_targetInodes.mid(first, length);
+    result.m_linkCounts = m_linkCounts.mid(first, length);
+    result.m_ownership = m_ownership.mid(first, length);
+    result.m_display = m_display.mid(first, length);
+    result.m_flags = m_flags.mid(first, length);
+    result.m_selectedCount = countSelected(first, result.count());
+    return result;
+}
+
+EntryTable EntryTable::reordered(const QVector<int>& order) const
+{
+    EntryTable result;
+    result.m_prefix = m_prefix;
+    result.reserve(order.count());
+
+    for (int row : order) {
+        result.appendRow(*this, row);
+    }
+
+    return result;
+}
+
+int EntryTable::indexOf(const QString& name) const
+{
+    return m_names.indexOf(name);
+}
+
+QString EntryTable::suffix(int row) const
+{
+    // same as QFileInfo::suffix()
+    const QString& fileName = m_names.at(row);
+    int lastDot = fileName.lastIndexOf('.');
+    if (lastDot < 0) return QString();
+    return fileName.mid(lastDot+1);
+}
+
+QString EntryTable::kind(int row) const
+{
+    if (isSymLink(row)) return "l";
+    if (S_ISDIR(lstatMode(row))) return "d";
+    if (isBlk(row)) return "b";
+    if (isChr(row)) return "c";
+    if (isFifo(row)) return "p";
+    if (isSocket(row)) return "s";
+    if (isFile(row)) return "-";
+    return "?";
+}
+
+QFile::Permissions EntryTable::permissions(int row) const
+{
+    // permissions of the target, as reported by QFileInfo
+    mode_t mode = statMode(row);
+    QFile::Permissions perms;
+    if (mode & S_IRUSR) perms |= QFile::ReadOwner;
+    if (mode & S_IWUSR) perms |= QFile::WriteOwner;
+    if (mode & S_IXUSR) perms |= QFile::ExeOwner;
+    if (mode & S_IRGRP) perms |= QFile::ReadGroup;
+    if (mode & S_IWGRP) perms |= QFile::WriteGroup;
+    if (mode & S_IXGRP) perms |= QFile::ExeGroup;
+    if (mode & S_IROTH) perms |= QFile::ReadOther;
+    if (mode & S_IWOTH) perms |= QFile::WriteOther;
+    if (mode & S_IXOTH) perms |= QFile::ExeOther;
+    return perms;
+}
+
+int EntryTable::estimatedDirSize(int row) const
+{
+    // Directories are linked from their parent, from their "." entry,
+    // and from the ".." entry of each subdirectory. Some file systems
+    // do not count links for directories and always report 1.
+    if (!isDirAtEnd(row)) return 0;
+    quint32 links = m_linkCounts.at(row);
+    return links >= 2 ? int(links - 2) : -1;
+}
+
+QDateTime EntryTable::lastModified(int row) const
+{
+    return QDateTime::fromMSecsSinceEpoch(m_modTimes.at(row) / 1000000LL);
+}
+
+int EntryTable::countSelected(int first, int count) const
+{
+    if (m_selectedCount == 0) return 0;
+
+    int selected = 0;
+    const quint8* flags = m_flags.constData() + first;
+    for (int i = 0; i < count; ++i) {
+        if (flags[i] & Selected) selected++;
+    }
+    return selected;
+}
+
+void EntryTable::setFlag(int row, Flag flag, bool set)
+{
+    if (flag == Selected && bool(m_flags.at(row) & Selected) != set) {
+        m_selectedCount += set ? 1 : -1;
+    }
+
+    if (set) m_flags[row] |= flag;
+    else m_flags[row] &= ~flag;
+}
+
+void EntryTable::invalidateDisplayStrings()
+{
+    s_displayGeneration.ref();
+}
+
+void EntryTable::updateDisplayStrings()
+{
+    const int generation = s_displayGeneration.loadAcquire();
+
+    // Many entries share the same strings, e.g. icon names or the
+    // modification time of files copied together. These are only
+    // stored once per call.
+    QHash<QString, QString> icons;
+    QHash<quint32, QString> permissionTexts;
+    QHash<qint64, QString> sizeTexts;
+    QHash<qint64, QString> modifiedTexts;
+
+    for (int row = 0; row < count(); ++row) {
+        if (m_display.at(row).generation == generation) continue;
+
+        DisplayStrings& display = m_display[row];
+        display.generation = generation;
+
+        QString icon = infoToIconName(*this, row);
+        auto iconIt = icons.constFind(icon);
+        if (iconIt == icons.constEnd()) iconIt = icons.insert(icon, icon);
+        display.icon = iconIt.value();
+
+        quint32 perms = quint32(permissions(row));
+        auto permsIt = permissionTexts.constFind(perms);
+        if (permsIt == permissionTexts.constEnd()) {
+            permsIt = permissionTexts.insert(perms, permissionsToString(permissions(row)));
+        }
+        display.permissions = permsIt.value();
+
+        // folder sizes are counted separately
+        if (isDir(row)) {
+            display.size = QString();
+        } else {
+            auto sizeIt = sizeTexts.constFind(size(row));
+            if (sizeIt == sizeTexts.constEnd()) {
+                sizeIt = sizeTexts.insert(size(row), filesizeToString(size(row)));
+            }
+            display.size = sizeIt.value();
+        }
+
+        auto modifiedIt = modifiedTexts.constFind(lastModifiedStat(row));
+        if (modifiedIt == modifiedTexts.constEnd()) {
+            modifiedIt = modifiedTexts.insert(lastModifiedStat(row), datetimeToString(lastModified(row)));
+        }
+        display.modified = modifiedIt.value();
+    }
+}
+
+qint64 EntryTable::estimatedMemoryUsage() const
+{
+    // column storage plus string data; QString stores a header
+    // of about 24 bytes and two bytes per character
+    qint64 usage = m_prefix.capacity() * 2 + 24;
+    usage += m_names.capacity() * qint64(sizeof(QString));
+    usage += m_nameHashes.capacity() * qint64(sizeof(uint));
+    usage += m_modes.capacity() * qint64(sizeof(quint32));
+    usage += m_sizes.capacity() * qint64(sizeof(qint64));
+    usage += m_modTimes.capacity() * qint64(sizeof(qint64));
+    usage += m_inodes.capacity() * qint64(sizeof(quint64));
+    usage += m_devices.capacity() * qint64(sizeof(quint64));
+    usage += m_targetInodes.capacity() * qint64(sizeof(quint64));
+    usage += m_linkCounts.capacity() * qint64(sizeof(quint32));
+    usage += m_ownership.capacity() * qint64(sizeof(quint64));
+    usage += m_display.capacity() * qint64(sizeof(DisplayStrings));
+    usage += m_flags.capacity() * qint64(sizeof(quint8));
+
+    for (const auto& name : m_names) {
+        usage += name.capacity() * 2 + 24;
+    }
+
+    // display strings are partly shared between entries, this is an upper bound
+    for (const auto& display : m_display) {
+        if (display.generation == 0) continue;
+        usage += (display.size.capacity() + display.modified.capacity()) * 2 + 48;
+    }
+
+    return usage;
+}
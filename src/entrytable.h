@@ -0,0 +1,197 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ENTRYTABLE_H
+#define ENTRYTABLE_H
+
+#include <QString>
+#include <QVector>
+#include <QDateTime>
+#include <QFile>
+#include <QAtomicInt>
+#include <sys/stat.h>
+
+/**
+ * @brief The EntryTable class stores the entries of one directory listing.
+ *
+ * Entries are kept column-wise: the directory path is stored once, names
+ * are kept as implicitly shared strings, and all metadata is packed into
+ * small columns. Copying a table is cheap because all columns are shared
+ * until they are modified, so the same names are used by the worker, the
+ * model, and any batches sent between them.
+ *
+ * Compared to a QList<StatFileInfo>, this saves the per-entry QFileInfo,
+ * two copies of struct stat, the full path, and a heap node per entry.
+ */
+class EntryTable
+{
+public:
+    enum Flag : quint8 {
+        NoFlags = 0,
+        Selected = 1 << 0,
+        Doomed = 1 << 1, // will be moved or deleted soon
+    };
+
+    explicit EntryTable();
+    explicit EntryTable(const QString& directory);
+
+    // directory path with trailing slash
+    const QString& directoryPrefix() const { return m_prefix; }
+
+    int count() const { return m_names.count(); }
+    bool isEmpty() const { return m_names.isEmpty(); }
+    void reserve(int size);
+    void clear();
+    void clearFlags();
+
+    // stat data of the entry itself and after following symlinks
+    void append(const QString& name, const struct stat& lstatData, const struct stat& statData);
+    void appendRow(const EntryTable& other, int row);
+    void appendRows(const EntryTable& other);
+    void insertRow(int at, const EntryTable& other, int row);
+    void insertRows(int at, const EntryTable& other, int first, int count);
+    void removeRow(int row);
+    void removeRows(int first, int count);
+    // same semantics as QAbstractItemModel::beginMoveRows()
+    void moveRows(int first, int count, int destination);
+    // replaces file metadata but keeps the view flags
+    void replaceRow(int row, const EntryTable& other, int otherRow);
+
+    // returns a copy of 'length' rows starting at 'first'
+    EntryTable mid(int first, int length = -1) const;
+    // returns a copy with rows in the given order
+    EntryTable reordered(const QVector<int>& order) const;
+
+    // index of the entry with this name or -1, linear search
+    int indexOf(const QString& name) const;
+
+    // names and paths
+    const QString& name(int row) const { return m_names.at(row); }
+    uint nameHash(int row) const { return m_nameHashes.at(row); }
+    QString absoluteFilePath(int row) const { return m_prefix + m_names.at(row); }
+    QString suffix(int row) const;
+
+    // these inspect the file itself without following symlinks
+    bool isSymLink(int row) const { return S_ISLNK(lstatMode(row)); }
+    bool isBlk(int row) const { return S_ISBLK(lstatMode(row)); }
+    bool isChr(int row) const { return S_ISCHR(lstatMode(row)); }
+    bool isFifo(int row) const { return S_ISFIFO(lstatMode(row)); }
+    bool isSocket(int row) const { return S_ISSOCK(lstatMode(row)); }
+    bool isFile(int row) const { return S_ISREG(lstatMode(row)); }
+
+    // these inspect the file or if it is a symlink, then its target end point
+    bool isDir(int row) const { return S_ISDIR(statMode(row)); }
+    bool isDirAtEnd(int row) const { return S_ISDIR(statMode(row)); }
+    bool isFileAtEnd(int row) const { return S_ISREG(statMode(row)); }
+
+    quint64 inode(int row) const { return m_inodes.at(row); }
+    // device and inode of the file or if it is a symlink, then its target
+    // end point, together they identify what the entry refers to
+    quint64 device(int row) const { return m_devices.at(row); }
+    quint64 targetInode(int row) const { return m_targetInodes.at(row); }
+    uint ownerId(int row) const { return uint(m_ownership.at(row) >> 32); }
+    uint groupId(int row) const { return uint(m_ownership.at(row) & 0xFFFFFFFF); }
+    QString kind(int row) const;
+    QFile::Permissions permissions(int row) const;
+    qint64 size(int row) const { return m_sizes.at(row); }
+    // Number of subdirectories according to the link count, or -1 if
+    // unknown. This is a lower bound of the number of entries.
+    int estimatedDirSize(int row) const;
+    qint64 lastModifiedStat(int row) const { return m_modTimes.at(row) / 1000000000LL; }
+    qint64 lastModifiedNsec(int row) const { return m_modTimes.at(row); }
+    QDateTime lastModified(int row) const;
+
+    // state of the entry in the view, not real file metadata
+    // The number of selected entries is kept up to date by all changes.
+    int selectedCount() const { return m_selectedCount; }
+    bool isSelected(int row) const { return m_flags.at(row) & Selected; }
+    void setSelected(int row, bool selected) { setFlag(row, Selected, selected); }
+    bool isDoomed(int row) const { return m_flags.at(row) & Doomed; }
+    void setDoomed(int row, bool doomed) { setFlag(row, Doomed, doomed); }
+
+    // Fingerprint of the name and metadata shown in the view, used to
+    // detect changes. It is computed from the stored columns and the
+    // precomputed name hash, so it never allocates.
+    quint64 fingerprint(int row) const {
+        quint64 hash = mix64((quint64(m_nameHashes.at(row)) << 32) | m_modes.at(row));
+        hash = mix64(hash ^ quint64(m_sizes.at(row)));
+        hash = mix64(hash ^ quint64(m_modTimes.at(row)));
+        hash = mix64(hash ^ m_ownership.at(row));
+        return mix64(hash ^ m_inodes.at(row));
+    }
+
+    // Strings shown in the view. They are prepared by updateDisplayStrings(),
+    // usually on the worker thread, and are empty before.
+    const QString& iconName(int row) const { return m_display.at(row).icon; }
+    const QString& permissionsText(int row) const { return m_display.at(row).permissions; }
+    const QString& sizeText(int row) const { return m_display.at(row).size; } // empty for folders
+    const QString& lastModifiedText(int row) const { return m_display.at(row).modified; }
+
+    // Prepares display strings of all entries that do not have them yet,
+    // or that were prepared before the last call to invalidateDisplayStrings().
+    void updateDisplayStrings();
+    // call when the date or the locale changed
+    static void invalidateDisplayStrings();
+
+    // approximate heap memory used by this table in bytes
+    qint64 estimatedMemoryUsage() const;
+
+private:
+    // the lower 16 bits hold the mode of the entry itself,
+    // the upper 16 bits hold the mode of the symlink target
+    mode_t lstatMode(int row) const { return m_modes.at(row) & 0xFFFF; }
+    mode_t statMode(int row) const { return (m_modes.at(row) >> 16) & 0xFFFF; }
+    void setFlag(int row, Flag flag, bool set);
+    int countSelected(int first, int count) const;
+
+    struct DisplayStrings {
+        QString icon;
+        QString permissions;
+        QString size;
+        QString modified;
+        int generation = {0}; // not prepared yet
+    };
+
+    // finalizer of splitmix64
+    static quint64 mix64(quint64 x) {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    QString m_prefix;
+    QVector<QString> m_names;
+    QVector<uint> m_nameHashes;
+    QVector<quint32> m_modes;
+    QVector<qint64> m_sizes;
+    QVector<qint64> m_modTimes; // nanoseconds since epoch
+    QVector<quint64> m_inodes;
+    QVector<quint64> m_devices; // of the target
+    QVector<quint64> m_targetInodes;
+    QVector<quint32> m_linkCounts;
+    QVector<quint64> m_ownership; // user id in the upper, group id in the lower half
+    QVector<quint8> m_flags;
+    int m_selectedCount = {0};
+    QVector<DisplayStrings> m_display;
+
+    static QAtomicInt s_displayGeneration;
+};
+
+#endif // ENTRYTABLE_H
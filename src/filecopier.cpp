@@ -0,0 +1,270 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <QFile>
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDebug>
+#include "filecopier.h"
+
+// Data copied in the kernel per call, between checks for cancellation.
+#ifndef FILECOPIER_CHUNK_SIZE
+#define FILECOPIER_CHUNK_SIZE (8*1024*1024)
+#endif
+
+// Buffer size of the fallback read/write loop.
+#ifndef FILECOPIER_BUFFER_SIZE
+#define FILECOPIER_BUFFER_SIZE (1024*1024)
+#endif
+
+// older kernel headers don't define it
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+namespace {
+// errors meaning that the method is not supported for these files
+bool isUnsupported(int error)
+{
+    return error == ENOSYS || error == EOPNOTSUPP || error == ENOTTY ||
+            error == EXDEV || error == EINVAL || error == EPERM;
+}
+
+ssize_t copyFileRange(int sourceFd, loff_t* sourceOffset, int destFd, loff_t* destOffset, size_t length)
+{
+#ifdef SYS_copy_file_range
+    // called directly, as glibc only provides a wrapper since 2.27
+    return syscall(SYS_copy_file_range, sourceFd, sourceOffset, destFd, destOffset, length, 0u);
+#else
+    Q_UNUSED(sourceFd) Q_UNUSED(sourceOffset) Q_UNUSED(destFd) Q_UNUSED(destOffset) Q_UNUSED(length)
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+}
+
+FileCopier::FileCopier(std::function<bool()> isCancelled,
+                       std::function<void(qint64)> progress) :
+    m_isCancelled(isCancelled), m_progress(progress)
+{
+}
+
+QString FileCopier::copy(const QString& source, const QString& destination, qint64 resumeOffset)
+{
+    m_errorString = "";
+    m_lastMethod = NoMethod;
+    m_wasCancelled = false;
+
+    int sourceFd = open(QFile::encodeName(source).constData(), O_RDONLY | O_CLOEXEC);
+    if (sourceFd < 0) {
+        return QString::fromLocal8Bit(strerror(errno));
+    }
+
+    struct stat sourceStat;
+    if (fstat(sourceFd, &sourceStat) != 0) {
+        QString error = QString::fromLocal8Bit(strerror(errno));
+        close(sourceFd);
+        return error;
+    }
+
+    QByteArray encodedDest = QFile::encodeName(destination);
+    int destFd = -1;
+    qint64 offset = 0;
+
+    if (resumeOffset > 0) {
+        destFd = open(encodedDest.constData(), O_WRONLY | O_CLOEXEC);
+        struct stat destStat;
+
+        if (destFd >= 0 && fstat(destFd, &destStat) == 0) {
+            // only data that actually reached the destination is kept
+            offset = qMin(resumeOffset, qMin(qint64(destStat.st_size), qint64(sourceStat.st_size)));
+            if (ftruncate(destFd, offset) != 0) offset = 0;
+        }
+
+        if (destFd >= 0 && offset == 0) {
+            close(destFd);
+            destFd = -1;
+            unlink(encodedDest.constData());
+        }
+    }
+
+    if (destFd < 0) {
+        destFd = open(encodedDest.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                      sourceStat.st_mode & 07777);
+    }
+
+    if (destFd < 0) {
+        QString error = QString::fromLocal8Bit(strerror(errno));
+        close(sourceFd);
+        return error;
+    }
+
+    reportProgress(offset);
+    bool ok = copyData(sourceFd, destFd, sourceStat.st_size, offset);
+
+    // the permissions passed to open() are limited by the umask
+    if (ok && fchmod(destFd, sourceStat.st_mode & 07777) != 0) {
+        m_errorString = QString::fromLocal8Bit(strerror(errno));
+        ok = false;
+    }
+
+    if (ok && m_preserveTimestamps) {
+        const struct timespec times[2] = {sourceStat.st_atim, sourceStat.st_mtim};
+        if (futimens(destFd, times) != 0) {
+            qDebug() << "[FileCopier] cannot set timestamps of" << destination << strerror(errno);
+        }
+    }
+
+    if (ok && m_synchronous && fsync(destFd) != 0) {
+        m_errorString = QString::fromLocal8Bit(strerror(errno));
+        ok = false;
+    }
+
+    if (close(destFd) != 0 && ok) {
+        // e.g. delayed write errors on network file systems
+        m_errorString = QString::fromLocal8Bit(strerror(errno));
+        ok = false;
+    }
+
+    close(sourceFd);
+
+    if (!ok) {
+        if (!m_keepIncomplete || !m_wasCancelled) unlink(encodedDest.constData());
+        return m_errorString;
+    }
+
+    return QString();
+}
+
+bool FileCopier::copyData(int sourceFd, int destFd, qint64 size, qint64 startOffset)
+{
+    const QString cancelled = QCoreApplication::translate("FileWorker", "Cancelled");
+
+    // Reflinks share all data, so the copy is done at once. They only
+    // work within one file system that supports them.
+    if (startOffset == 0 && size > 0 && ioctl(destFd, FICLONE, sourceFd) == 0) {
+        m_lastMethod = Clone;
+        reportProgress(size);
+        return true;
+    }
+
+    loff_t offset = startOffset;
+
+    // in-kernel copy, also uses server-side copies on NFS
+    m_lastMethod = CopyFileRange;
+    while (offset < size) {
+        if (isCancelled()) {
+            m_errorString = cancelled;
+            m_wasCancelled = true;
+            return false;
+        }
+
+        loff_t destOffset = offset;
+        ssize_t copied = copyFileRange(sourceFd, &offset, destFd, &destOffset,
+                                       size_t(qMin(qint64(FILECOPIER_CHUNK_SIZE), size - offset)));
+        if (copied < 0) {
+            if (errno == EINTR) continue;
+            if (isUnsupported(errno)) break; // try the next method
+            m_errorString = QString::fromLocal8Bit(strerror(errno));
+            return false;
+        } else if (copied == 0) {
+            break; // the source got shorter, or a special file system
+        }
+        reportProgress(copied);
+    }
+
+    // sendfile writes at the current position of the destination
+    if (offset < size && lseek(destFd, offset, SEEK_SET) < 0) {
+        m_errorString = QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+
+    if (offset < size) m_lastMethod = SendFile;
+    while (offset < size) {
+        if (isCancelled()) {
+            m_errorString = cancelled;
+            m_wasCancelled = true;
+            return false;
+        }
+
+        off_t sourceOffset = offset;
+        ssize_t copied = sendfile(destFd, sourceFd, &sourceOffset,
+                                  size_t(qMin(qint64(FILECOPIER_CHUNK_SIZE), size - offset)));
+        if (copied < 0) {
+            if (errno == EINTR) continue;
+            if (isUnsupported(errno)) break;
+            m_errorString = QString::fromLocal8Bit(strerror(errno));
+            return false;
+        } else if (copied == 0) {
+            break;
+        }
+        offset += copied;
+        reportProgress(copied);
+    }
+
+    // Last resort, and always used to read until the end of the file:
+    // files in /proc, sysfs, or some FUSE file systems report a size of
+    // zero or too small. For all other files, this reads nothing.
+    if (lseek(destFd, offset, SEEK_SET) < 0) {
+        m_errorString = QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+
+    if (offset < size || size == 0) m_lastMethod = ReadWrite;
+    QByteArray buffer(FILECOPIER_BUFFER_SIZE, Qt::Uninitialized);
+    while (true) {
+        if (isCancelled()) {
+            m_errorString = cancelled;
+            m_wasCancelled = true;
+            return false;
+        }
+
+        ssize_t bytesRead = pread(sourceFd, buffer.data(), size_t(buffer.size()), offset);
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            m_errorString = QString::fromLocal8Bit(strerror(errno));
+            return false;
+        } else if (bytesRead == 0) {
+            return true; // end of file
+        }
+
+        for (ssize_t written = 0; written < bytesRead;) {
+            ssize_t result = write(destFd, buffer.constData() + written, size_t(bytesRead - written));
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                m_errorString = QString::fromLocal8Bit(strerror(errno));
+                return false;
+            }
+            written += result;
+        }
+
+        offset += bytesRead;
+        reportProgress(bytesRead);
+    }
+}
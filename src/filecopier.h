@@ -0,0 +1,87 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FILECOPIER_H
+#define FILECOPIER_H
+
+#include <functional>
+#include <QString>
+
+/**
+ * @brief The FileCopier class copies the contents of regular files.
+ *
+ * The fastest method supported by the file systems involved is used:
+ * first the destination is made a reflink of the source (FICLONE), which
+ * shares all data blocks on btrfs or XFS. Otherwise the kernel copies the
+ * data using copy_file_range, or else sendfile, without passing it through
+ * user space. A plain read/write loop is only used if none of these work.
+ *
+ * Data is copied in chunks, so that copying can be cancelled or paused
+ * in the middle of large files, and progress is reported per chunk.
+ *
+ * The destination must not exist, unless an interrupted copy is resumed.
+ * It gets the permissions of the source, and is removed again if copying
+ * fails or is cancelled, unless it is kept to be resumed later.
+ */
+class FileCopier
+{
+public:
+    enum Method {
+        NoMethod, Clone, CopyFileRange, SendFile, ReadWrite
+    };
+
+    // isCancelled is polled between chunks and cancels copying if it returns
+    // true, it may also block to pause copying; progress receives the number
+    // of bytes copied since its last call
+    explicit FileCopier(std::function<bool()> isCancelled = {},
+                        std::function<void(qint64)> progress = {});
+
+    // returns an error message, or an empty string on success; with a resume
+    // offset, an existing destination is continued instead of copied again
+    QString copy(const QString& source, const QString& destination, qint64 resumeOffset = 0);
+
+    // the method that copied the last file, for debugging
+    Method lastMethod() const { return m_lastMethod; }
+
+    // flush the data to disk before copy() returns, e.g. before the source is removed
+    void setSynchronous(bool synchronous) { m_synchronous = synchronous; }
+    // give the destination the access and modification times of the source
+    void setPreserveTimestamps(bool preserve) { m_preserveTimestamps = preserve; }
+    // keep an incomplete destination if copying is cancelled, so that it can be resumed
+    void setKeepIncomplete(bool keep) { m_keepIncomplete = keep; }
+    bool wasCancelled() const { return m_wasCancelled; }
+
+private:
+    bool copyData(int sourceFd, int destFd, qint64 size, qint64 startOffset);
+    bool isCancelled() const { return m_isCancelled && m_isCancelled(); }
+    void reportProgress(qint64 bytes) { if (m_progress && bytes > 0) m_progress(bytes); }
+
+    std::function<bool()> m_isCancelled;
+    std::function<void(qint64)> m_progress;
+    Method m_lastMethod = {NoMethod};
+    bool m_synchronous = {false};
+    bool m_preserveTimestamps = {false};
+    bool m_keepIncomplete = {false};
+    bool m_wasCancelled = {false};
+    QString m_errorString;
+};
+
+#endif // FILECOPIER_H
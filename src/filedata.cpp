@@ -22,10 +22,10 @@
 #include "filedata.h"
 #include <QDir>
 #include <QDateTime>
-#include <QMimeDatabase>
 #include <QImageReader>
 #include <QSettings>
 #include "globals.h"
+#include "mimeservice.h"
 #include "jhead/jhead-api.h"
 
 FileData::FileData(QObject *parent) :
@@ -244,10 +244,9 @@ void FileData::readMetaData()
 
     // normal files - match content to find mimetype, which means that the file is read
 
-    QMimeDatabase db;
     QString filename = m_fileInfo.isSymLink() ? m_fileInfo.symLinkTarget() :
                                                 m_fileInfo.absoluteFilePath();
-    m_mimeType = db.mimeTypeForFile(filename);
+    m_mimeType = MimeService::instance()->mimeTypeForFile(filename);
     m_mimeTypeName = m_mimeType.name();
     m_mimeTypeComment = m_mimeType.comment();
 
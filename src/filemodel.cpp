@@ -20,19 +20,42 @@
  * this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <cerrno>
 #include <unistd.h>
-#include <QDateTime>
-#include <QMimeType>
-#include <QMimeDatabase>
+#include <sys/stat.h>
+#include <QFileInfo>
 #include <QSettings>
 #include <QGuiApplication>
 #include <QRegularExpression>
+#include <QHash>
+#include <QVector>
 #include <QDebug>
 
 #include "filemodel.h"
 #include "filemodelworker.h"
+#include "directorycache.h"
 #include "settingshandler.h"
 #include "globals.h"
+#include "doomedregistry.h"
+#include "displaystringswatcher.h"
+#include "mimeservice.h"
+#include "usernamecache.h"
+
+// Subdirectories are prefetched after the view was idle this long.
+#ifndef FILEMODEL_IDLE_PREFETCH_DELAY_MSEC
+#define FILEMODEL_IDLE_PREFETCH_DELAY_MSEC 1500
+#endif
+
+// Maximum number of subdirectories prefetched while idle.
+#ifndef FILEMODEL_IDLE_PREFETCH_LIMIT
+#define FILEMODEL_IDLE_PREFETCH_LIMIT 16
+#endif
+
+// Maximum number of subdirectories checked while idle, including
+// those that are already cached and are not read again.
+#ifndef FILEMODEL_IDLE_PREFETCH_CHECK_LIMIT
+#define FILEMODEL_IDLE_PREFETCH_CHECK_LIMIT 128
+#endif
 
 enum {
     FilenameRole = Qt::UserRole + 1,
@@ -46,7 +69,9 @@ enum {
     IsLinkRole = Qt::UserRole + 9,
     SymLinkTargetRole = Qt::UserRole + 10,
     IsSelectedRole = Qt::UserRole + 11,
-    IsDoomedRole = Qt::UserRole + 12
+    IsDoomedRole = Qt::UserRole + 12,
+    OwnerRole = Qt::UserRole + 13,
+    GroupRole = Qt::UserRole + 14
 };
 
 FileModel::FileModel(QObject *parent) :
@@ -55,11 +80,28 @@ FileModel::FileModel(QObject *parent) :
     m_active(false)
 {
     m_worker = new FileModelWorker;
+    m_prefetchWorker = new FileModelWorker;
     m_dir = "";
 
-    m_watcher = new QFileSystemWatcher(this);
-    connect(m_watcher, SIGNAL(directoryChanged(const QString&)), this, SLOT(refresh()));
-    connect(m_watcher, SIGNAL(fileChanged(const QString&)), this, SLOT(refresh()));
+    // only changed entries are updated if the watcher knows them
+    // Bursts of changes are merged before the directory is read again.
+    m_watcher = new DirectoryWatcher(this);
+    m_scheduler = new RefreshScheduler(this);
+    connect(m_watcher, &DirectoryWatcher::directoryChanged, m_scheduler, &RefreshScheduler::addFullRefresh);
+    connect(m_watcher, &DirectoryWatcher::entriesChanged, m_scheduler, &RefreshScheduler::addEntries);
+    connect(m_scheduler, &RefreshScheduler::fullRefreshRequested, this, &FileModel::refresh);
+    connect(m_scheduler, &RefreshScheduler::entriesRefreshRequested, this, &FileModel::refreshEntries);
+
+    // folders are counted in the background when they are shown
+    m_childCounter = new ChildCounter(this);
+    connect(m_childCounter, &ChildCounter::countReady, this, &FileModel::childCountReady);
+
+    // dates of today are shown differently, and all strings depend on the locale
+    connect(DisplayStringsWatcher::instance(), &DisplayStringsWatcher::invalidated,
+            this, &FileModel::refreshDisplayStrings);
+
+    // doomed entries are shared by all models
+    connect(DoomedRegistry::instance(), &DoomedRegistry::changed, this, &FileModel::doomedEntriesChanged);
 
     // refresh model every time view settings are changed
     m_settings = qApp->property("settings").value<Settings*>();
@@ -68,17 +110,31 @@ FileModel::FileModel(QObject *parent) :
 
     // sync worker status
     connect(m_worker, &FileModelWorker::done, this, &FileModel::workerDone);
+    connect(m_worker, &FileModelWorker::batchLoaded, this, &FileModel::workerLoadedBatch);
     connect(m_worker, &FileModelWorker::error, this, &FileModel::workerErrorOccurred);
-    connect(m_worker, &FileModelWorker::entryAdded, this, &FileModel::workerAddedEntry);
-    connect(m_worker, &FileModelWorker::entryRemoved, this, &FileModel::workerRemovedEntry);
+    connect(m_worker, &FileModelWorker::changesFound, this, &FileModel::workerFoundChanges);
+
+    // changes are held back while the worker is running
+    connect(m_worker, &FileModelWorker::started, m_scheduler, [&](){ m_scheduler->setHeld(true); });
+    connect(m_worker, &FileModelWorker::finished, m_scheduler, [&](){ m_scheduler->setHeld(false); });
+
+    // directories are listed in advance and put into the cache
+    m_idlePrefetchTimer = new QTimer(this);
+    m_idlePrefetchTimer->setSingleShot(true);
+    m_idlePrefetchTimer->setInterval(FILEMODEL_IDLE_PREFETCH_DELAY_MSEC);
+    connect(m_idlePrefetchTimer, &QTimer::timeout, this, &FileModel::prefetchSubdirectories);
+    connect(m_prefetchWorker, &FileModelWorker::finished, this, &FileModel::prefetchFinished);
 }
 
 FileModel::~FileModel()
 {
-    // stop and delete the worker
+    // stop and delete the workers
     m_worker->cancel();
     m_worker->wait();
     m_worker->deleteLater();
+    m_prefetchWorker->cancel();
+    m_prefetchWorker->wait();
+    m_prefetchWorker->deleteLater();
 }
 
 int FileModel::rowCount(const QModelIndex &parent) const
@@ -89,55 +145,65 @@ int FileModel::rowCount(const QModelIndex &parent) const
 
 QVariant FileModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid() || index.row() > m_files.size()-1)
+    if (!index.isValid() || index.row() > m_files.count()-1)
         return QVariant();
 
-    StatFileInfo info = m_files.at(index.row());
+    const int row = index.row();
     switch (role) {
 
     case Qt::DisplayRole:
     case FilenameRole:
-        return info.fileName();
+        return m_files.name(row);
 
     case FileKindRole:
-        return info.kind();
+        return m_files.kind(row);
 
+    // display strings are prepared by the worker
     case FileIconRole:
-        return infoToIconName(info);
+        return m_files.iconName(row);
 
     case PermissionsRole:
-        return permissionsToString(info.permissions());
+        return m_files.permissionsText(row);
 
     case SizeRole:
-        if (info.isDir()) {
-            uint size = info.dirSize();
-            //: as in "this folder is empty", but as short as possible
-            if (size == 0) return tr("empty");
-            else return tr("%n item(s)", "", static_cast<int>(size));
+        if (m_files.isDir(row)) {
+            return dirSizeToString(row);
         } else {
-            return filesizeToString(info.size());
+            return m_files.sizeText(row);
         }
 
     case LastModifiedRole:
-        return datetimeToString(info.lastModified());
+        return m_files.lastModifiedText(row);
 
     case CreatedRole:
-        return datetimeToString(info.created());
+        // rarely used, so it is not kept in the table
+        return datetimeToString(QFileInfo(m_files.absoluteFilePath(row)).created());
 
     case IsDirRole:
-        return info.isDirAtEnd();
+        return m_files.isDirAtEnd(row);
 
     case IsLinkRole:
-        return info.isSymLink();
+        return m_files.isSymLink(row);
 
     case SymLinkTargetRole:
-        return info.symLinkTarget();
+        if (!m_files.isSymLink(row)) return QString();
+        return QFileInfo(m_files.absoluteFilePath(row)).symLinkTarget();
 
     case IsSelectedRole:
-        return info.isSelected();
+        return m_files.isSelected(row);
 
     case IsDoomedRole:
-        return info.isDoomed();
+        return m_files.isDoomed(row);
+
+    case OwnerRole: {
+        QString name = UserNameCache::instance()->userName(m_files.ownerId(row));
+        return name.isEmpty() ? QString::number(m_files.ownerId(row)) : name;
+    }
+
+    case GroupRole: {
+        QString name = UserNameCache::instance()->groupName(m_files.groupId(row));
+        return name.isEmpty() ? QString::number(m_files.groupId(row)) : name;
+    }
 
     default:
         return QVariant();
@@ -159,6 +225,8 @@ QHash<int, QByteArray> FileModel::roleNames() const
     roles.insert(SymLinkTargetRole, QByteArray("symLinkTarget"));
     roles.insert(IsSelectedRole, QByteArray("isSelected"));
     roles.insert(IsDoomedRole, QByteArray("isDoomed"));
+    roles.insert(OwnerRole, QByteArray("owner"));
+    roles.insert(GroupRole, QByteArray("group"));
     return roles;
 }
 
@@ -178,10 +246,10 @@ void FileModel::setDir(QString dir)
         return;
 
     // update watcher to watch the new directory
-    if (!m_dir.isEmpty())
-        m_watcher->removePath(m_dir);
-    if (!dir.isEmpty())
-        m_watcher->addPath(dir);
+    m_watcher->setDirectory(dir);
+    m_scheduler->clear();
+    m_childCounter->cancelPending();
+    cancelPrefetch();
 
     m_dir = dir;
 
@@ -203,11 +271,15 @@ void FileModel::setActive(bool active)
 
     m_active = active;
     emit activeChanged();
+    if (!m_active) cancelPrefetch(true);
 
     switch (m_scheduledRefresh) {
     case FileModelWorker::Mode::NoneMode:
+    case FileModelWorker::Mode::PrefetchMode:
         break; // nothing to refresh
     case FileModelWorker::Mode::DiffMode:
+    case FileModelWorker::Mode::UpdateMode:
+    case FileModelWorker::Mode::ProjectMode:
         doUpdateChangedEntries();
         break;
     case FileModelWorker::Mode::FullMode:
@@ -237,7 +309,7 @@ QString FileModel::fileNameAt(int fileIndex)
     if (fileIndex < 0 || fileIndex >= m_files.count())
         return QString();
 
-    return m_files.at(fileIndex).absoluteFilePath();
+    return m_files.absoluteFilePath(fileIndex);
 }
 
 QString FileModel::mimeTypeAt(int fileIndex) {
@@ -245,74 +317,33 @@ QString FileModel::mimeTypeAt(int fileIndex) {
 
     if (file.isEmpty()) return QString();
 
-    QMimeDatabase db;
-    QMimeType type = db.mimeTypeForFile(file);
-    return type.name();
+    // usually cached or known by name, see MimeService
+    return MimeService::instance()->mimeTypeNameForFile(file);
 }
 
 void FileModel::toggleSelectedFile(int fileIndex)
 {
-    if (fileIndex >= m_files.length() || fileIndex < 0) return; // fail silently
-
-    StatFileInfo info = m_files.at(fileIndex);
-
-    if (!m_files.at(fileIndex).isSelected()) {
-        info.setSelected(true);
-        m_selectedFileCount++;
-    } else {
-        info.setSelected(false);
-        m_selectedFileCount--;
-    }
-
-    m_files[fileIndex] = info;
-    QModelIndex topLeft = index(fileIndex, 0);
-    QModelIndex bottomRight = index(fileIndex, 0);
-    emit dataChanged(topLeft, bottomRight, {IsSelectedRole});
-    emit selectedFileCountChanged();
+    if (fileIndex >= m_files.count() || fileIndex < 0) return; // fail silently
+    setRangeSelected(fileIndex, fileIndex, !m_files.isSelected(fileIndex));
 }
 
 void FileModel::clearSelectedFiles()
 {
-    QMutableListIterator<StatFileInfo> iter(m_files);
-    int row = 0;
-    while (iter.hasNext()) {
-        StatFileInfo &info = iter.next();
-        info.setSelected(false);
-        // emit signal for views
-        QModelIndex topLeft = index(row, 0);
-        QModelIndex bottomRight = index(row, 0);
-        emit dataChanged(topLeft, bottomRight, {IsSelectedRole});
-        row++;
-    }
-    m_selectedFileCount = 0;
-    emit selectedFileCountChanged();
+    if (m_files.selectedCount() == 0) return;
+    setRangeSelected(0, m_files.count()-1, false);
 }
 
 void FileModel::selectAllFiles()
 {
-    QMutableListIterator<StatFileInfo> iter(m_files);
-    int row = 0; int count = 0;
-
-    while (iter.hasNext()) {
-        StatFileInfo &info = iter.next();
-        info.setSelected(true);
-        // emit signal for views
-        QModelIndex topLeft = index(row, 0);
-        QModelIndex bottomRight = index(row, 0);
-        emit dataChanged(topLeft, bottomRight, {IsSelectedRole});
-        row++; count++;
-    }
-
-    m_selectedFileCount = count;
-    emit selectedFileCountChanged();
+    setRangeSelected(0, m_files.count()-1, true);
 }
 
 void FileModel::selectRange(int firstIndex, int lastIndex, bool selected)
 {
     // fail silently if indices are invalid
-    if (   firstIndex >= m_files.length()
+    if (   firstIndex >= m_files.count()
         || firstIndex < 0
-        || lastIndex >= m_files.length()
+        || lastIndex >= m_files.count()
         || lastIndex < 0
        ) return;
 
@@ -320,29 +351,7 @@ void FileModel::selectRange(int firstIndex, int lastIndex, bool selected)
         std::swap(firstIndex, lastIndex);
     }
 
-    QMutableListIterator<StatFileInfo> iter(m_files);
-    int row = 0; int count = 0;
-    while (iter.hasNext()) {
-        StatFileInfo &info = iter.next();
-
-        if (   row >= firstIndex
-            && row <= lastIndex
-            && info.isSelected() != selected) {
-            info.setSelected(selected);
-            // emit signal for views
-            QModelIndex topLeft = index(row, 0);
-            QModelIndex bottomRight = index(row, 0);
-            emit dataChanged(topLeft, bottomRight, {IsSelectedRole});
-        }
-
-        if (info.isSelected()) count++;
-        row++;
-    }
-
-    if (count != m_selectedFileCount) {
-        m_selectedFileCount = count;
-        emit selectedFileCountChanged();
-    }
+    setRangeSelected(firstIndex, lastIndex, selected);
 }
 
 QStringList FileModel::selectedFiles() const
@@ -350,42 +359,191 @@ QStringList FileModel::selectedFiles() const
     if (m_selectedFileCount == 0)
         return QStringList();
 
+    // paths are only built for selected entries
     QStringList filenames;
-    foreach (const StatFileInfo &info, m_files) {
-        if (info.isSelected())
-            filenames.append(info.absoluteFilePath());
+    filenames.reserve(m_selectedFileCount);
+    for (int row = 0; row < m_files.count() && filenames.count() < m_selectedFileCount; ++row) {
+        if (m_files.isSelected(row))
+            filenames.append(m_files.absoluteFilePath(row));
     }
     return filenames;
 }
 
+void FileModel::setRangeSelected(int first, int last, bool selected)
+{
+    // views are notified once per contiguous range of changed rows
+    int changedFirst = -1;
+    for (int row = first; row <= last + 1; ++row) {
+        if (row <= last && m_files.isSelected(row) != selected) {
+            m_files.setSelected(row, selected);
+            if (changedFirst < 0) changedFirst = row;
+        } else if (changedFirst >= 0) {
+            emit dataChanged(index(changedFirst, 0), index(row-1, 0), {IsSelectedRole});
+            changedFirst = -1;
+        }
+    }
+
+    updateFileCounts();
+}
+
 void FileModel::markSelectedAsDoomed()
 {
-    doMarkAsDoomed(m_files, [](StatFileInfo& info){
-        if (info.isSelected()) return true;
-        return false;
-    });
+    DoomedRegistry::instance()->add(selectedFiles());
 }
 
 void FileModel::markAsDoomed(QStringList absoluteFilePaths)
 {
-    doMarkAsDoomed(m_files, [&absoluteFilePaths](StatFileInfo& info){
-        if (absoluteFilePaths.contains(info.absoluteFilePath())) return true;
-        return false;
-    });
-}
-
-void FileModel::doMarkAsDoomed(QList<StatFileInfo>& files, std::function<bool(StatFileInfo&)> checker) {
-    // TODO this should save the affected paths in a
-    // global (runtime) registry so it won't be lost when
-    // refreshing the model and when changing directories
-    for (int i = 0; i < files.size(); i++) {
-        if (checker(files[i])) {
-            files[i].setDoomed(true);
-            files[i].setSelected(false); // doomed files can't be selected
-            emit dataChanged(index(i, 0), index(i, 0), {IsDoomedRole, IsSelectedRole});
+    DoomedRegistry::instance()->add(absoluteFilePaths);
+}
+
+void FileModel::doomedEntriesChanged(QString directory)
+{
+    if (directory == m_files.directoryPrefix()) applyDoomedEntries(false);
+}
+
+void FileModel::applyDoomedEntries(bool releaseMissing)
+{
+    DoomedRegistry* registry = DoomedRegistry::instance();
+    QSet<QString> doomed = registry->names(m_files.directoryPrefix());
+    if (doomed.isEmpty() && !m_hasDoomed) return; // nothing to do
+
+    // Doomed entries that are not listed may be gone, or they may only be
+    // hidden by the filter or because hidden files are not shown.
+    QSet<QString> missing;
+    if (releaseMissing) missing = doomed;
+
+    m_hasDoomed = false;
+    int changedFirst = -1;
+    for (int row = 0; row <= m_files.count(); ++row) {
+        bool changed = false;
+
+        if (row < m_files.count()) {
+            bool isDoomed = !doomed.isEmpty() && doomed.contains(m_files.name(row));
+            if (isDoomed) {
+                m_hasDoomed = true;
+                missing.remove(m_files.name(row));
+            }
+
+            if (isDoomed != m_files.isDoomed(row)) {
+                m_files.setDoomed(row, isDoomed);
+                if (isDoomed) m_files.setSelected(row, false); // doomed files can't be selected
+                changed = true;
+            }
+        }
+
+        if (changed) {
+            if (changedFirst < 0) changedFirst = row;
+        } else if (changedFirst >= 0) {
+            emit dataChanged(index(changedFirst, 0), index(row-1, 0), {IsDoomedRole, IsSelectedRole});
+            changedFirst = -1;
         }
     }
+
     updateFileCounts();
+
+    if (!missing.isEmpty()) {
+        // only few entries are doomed at a time, so checking them is cheap
+        QStringList paths;
+        paths.reserve(missing.count());
+        struct stat buffer;
+        for (const auto& name : missing) {
+            QString path = m_files.directoryPrefix() + name;
+            if (lstat(QFile::encodeName(path).constData(), &buffer) != 0 && errno == ENOENT) {
+                paths.append(path);
+            }
+        }
+        if (!paths.isEmpty()) registry->release(paths);
+    }
+}
+
+void FileModel::prefetch(int fileIndex)
+{
+    // Called when an entry is pressed, so the listing is
+    // hopefully ready when the new page is shown.
+    if (fileIndex < 0 || fileIndex >= m_files.count()) return;
+    if (!m_files.isDirAtEnd(fileIndex)) return;
+
+    QString path = m_files.absoluteFilePath(fileIndex);
+    if (m_prefetchQueueIdle) {
+        m_prefetchQueue.clear();
+        m_prefetchQueueIdle = false;
+        m_idlePrefetchRow = -1;
+    }
+    m_prefetchQueue.removeAll(path);
+    m_prefetchQueue.prepend(path);
+    m_idlePrefetchTimer->stop();
+
+    if (m_prefetchWorker->isIdlePrefetch()) {
+        // requested prefetches take precedence
+        m_prefetchWorker->cancel();
+    } else if (!m_prefetchWorker->isRunning()) {
+        startNextPrefetch();
+    }
+}
+
+void FileModel::prefetchWhenIdle()
+{
+    if (!m_active || m_busy) return;
+    m_idlePrefetchTimer->start();
+}
+
+void FileModel::cancelPrefetch(bool keepRequested)
+{
+    m_idlePrefetchTimer->stop();
+
+    if (keepRequested) {
+        // only drop idle prefetches, e.g. when leaving the page
+        // after an entry was pressed to open it
+        if (m_prefetchQueueIdle) m_prefetchQueue.clear();
+        if (m_prefetchWorker->isIdlePrefetch()) m_prefetchWorker->cancel();
+        m_idlePrefetchRow = -1;
+        return;
+    }
+
+    m_prefetchQueue.clear();
+    m_idlePrefetchRow = -1;
+    if (m_prefetchWorker->isRunning()) m_prefetchWorker->cancel();
+}
+
+void FileModel::prefetchSubdirectories()
+{
+    if (!m_active || !m_prefetchQueue.isEmpty()) return;
+
+    // Subdirectories are queued one at a time. The worker skips those
+    // that are already cached, so they only count towards the check limit.
+    m_prefetchQueueIdle = true;
+    m_idlePrefetchRow = 0;
+    m_idlePrefetchesLeft = FILEMODEL_IDLE_PREFETCH_LIMIT;
+    m_idleChecksLeft = FILEMODEL_IDLE_PREFETCH_CHECK_LIMIT;
+    if (!m_prefetchWorker->isRunning()) startNextPrefetch();
+}
+
+void FileModel::prefetchFinished()
+{
+    if (m_prefetchWorker->isIdlePrefetch() && !m_prefetchWorker->wasCached()) {
+        --m_idlePrefetchesLeft;
+    }
+
+    startNextPrefetch();
+}
+
+void FileModel::startNextPrefetch()
+{
+    if (m_prefetchWorker->isRunning()) return;
+
+    if (m_prefetchQueue.isEmpty() && m_prefetchQueueIdle && m_idlePrefetchRow >= 0) {
+        while (m_idlePrefetchRow < m_files.count()
+               && m_idlePrefetchesLeft > 0 && m_idleChecksLeft > 0) {
+            int row = m_idlePrefetchRow++;
+            if (!m_files.isDirAtEnd(row)) continue;
+            --m_idleChecksLeft;
+            m_prefetchQueue.append(m_files.absoluteFilePath(row));
+            break;
+        }
+    }
+
+    if (m_prefetchQueue.isEmpty()) return;
+    m_prefetchWorker->startPrefetch(m_prefetchQueue.takeFirst(), m_settings, m_prefetchQueueIdle);
 }
 
 void FileModel::refresh()
@@ -399,9 +557,32 @@ void FileModel::refresh()
         return;
     }
 
+    if (m_worker->isRunning()) {
+        // refreshed again when the worker is finished
+        m_scheduler->addFullRefresh();
+        return;
+    }
+
     doUpdateChangedEntries();
 }
 
+void FileModel::refreshEntries(QStringList names)
+{
+    if (!m_active) {
+        // the whole directory will be compared when activated
+        refresh();
+        return;
+    }
+
+    if (m_worker->isRunning()) {
+        // checked again when the worker is finished
+        m_scheduler->addEntries(names);
+        return;
+    }
+
+    doUpdateEntries(names);
+}
+
 void FileModel::refreshFull(QString localPath)
 {
     if (!localPath.isEmpty() && localPath != m_dir) {
@@ -414,38 +595,144 @@ void FileModel::refreshFull(QString localPath)
         return;
     }
 
-    doUpdateAllEntries();
+    doReprojectEntries();
+}
+
+void FileModel::childCountReady(QString path, quint64 device, quint64 inode, qint64 modTime, int row, int count)
+{
+    Q_UNUSED(count)
+    const QString& prefix = m_files.directoryPrefix();
+    if (!path.startsWith(prefix)) return; // outdated count for a previous directory
+
+    // The row was recorded when the count was requested. Only search for
+    // the entry if rows were inserted, removed or moved since then.
+    const int prefixLength = prefix.length();
+    if (row < 0 || row >= m_files.count()
+            || m_files.name(row).length() != path.length() - prefixLength
+            || !path.endsWith(m_files.name(row))) {
+        row = m_files.indexOf(path.mid(prefixLength));
+    }
+
+    if (row < 0 || m_files.device(row) != device || m_files.targetInode(row) != inode
+            || m_files.lastModifiedNsec(row) != modTime) {
+        return;
+    }
+
+    QModelIndex changed = index(row, 0);
+    emit dataChanged(changed, changed, {SizeRole});
+}
+
+void FileModel::refreshDisplayStrings()
+{
+    // invalidated once for all models by the watcher
+    m_files.updateDisplayStrings();
+
+    if (!m_files.isEmpty()) {
+        emit dataChanged(index(0, 0), index(m_files.count()-1, 0), {SizeRole, LastModifiedRole});
+    }
 }
 
 void FileModel::applyFilterString()
 {
-    if (m_oldFilterString != m_filterString &&
-            !m_dir.isEmpty()) refresh();
+    if (m_oldFilterString == m_filterString || m_dir.isEmpty()) return;
+
+    if (!m_active) {
+        refresh();
+        return;
+    }
+
+    doReprojectEntries();
 }
 
-void FileModel::workerDone(FileModelWorker::Mode mode, QList<StatFileInfo> files)
+void FileModel::workerDone(FileModelWorker::Mode mode, EntryTable files)
 {
-    if (mode == FileModelWorker::Mode::DiffMode) {
-        // main work is already handled in workerAddedEntry() and
-        // workerRemovedEntry(), triggered by the resp. signals
-        // TODO emit fileCountChanged();
+    if (mode == FileModelWorker::Mode::DiffMode || mode == FileModelWorker::Mode::UpdateMode ||
+            mode == FileModelWorker::Mode::ProjectMode) {
+        // main work is already handled in workerFoundChanges()
     } else if (mode == FileModelWorker::Mode::FullMode) {
-        setBusy(m_busy, false); // make sure we're busy
-        beginResetModel();
-        m_files.clear();
-        m_files = files;
-        endResetModel();
-        emit fileCountChanged();
+        if (!m_streamed || !applyStreamedOrder(files)) {
+            setBusy(m_busy, false); // make sure we're busy
+            beginResetModel();
+            m_files.clear();
+            m_files = files;
+            endResetModel();
+            emit fileCountChanged();
+        }
+        m_streamed = false;
     }
 
     updateFileCounts();
+    applyDoomedEntries(true);
+
+    // files that can't be classified by name are read in the background
+    if (mode != FileModelWorker::Mode::UpdateMode) {
+        MimeService::instance()->classifyInBackground(m_files);
+    }
     m_errorMessage = ""; // worker finished successfully
     emit errorMessageChanged();
     setBusy(false, false);
+    prefetchWhenIdle();
+}
+
+void FileModel::workerLoadedBatch(QString dir, EntryTable files, bool first)
+{
+    if (dir != m_dir) return; // outdated batch for a previous directory
+
+    if (first) {
+        beginResetModel();
+        m_files = files;
+        endResetModel();
+        m_streamed = true;
+        setBusy(false, true); // the rest is still loading
+    } else if (m_streamed && !files.isEmpty()) {
+        beginInsertRows(QModelIndex(), m_files.count(), m_files.count()+files.count()-1);
+        m_files.appendRows(files);
+        endInsertRows();
+    } else {
+        return;
+    }
+
+    emit fileCountChanged();
+    applyDoomedEntries(false);
+}
+
+bool FileModel::applyStreamedOrder(EntryTable& files)
+{
+    if (files.count() != m_files.count()) return false;
+
+    QHash<QString, int> newRows;
+    newRows.reserve(files.count());
+    for (int i = 0; i < files.count(); ++i) {
+        newRows.insert(files.name(i), i);
+    }
+
+    // map old rows to new rows, keeping selections made while loading
+    QVector<int> rowMap(m_files.count(), -1);
+    for (int i = 0; i < m_files.count(); ++i) {
+        int newRow = newRows.value(m_files.name(i), -1);
+        if (newRow < 0) return false;
+        rowMap[i] = newRow;
+        if (m_files.isSelected(i)) files.setSelected(newRow, true);
+    }
+
+    emit layoutAboutToBeChanged();
+
+    QModelIndexList oldIndexes = persistentIndexList();
+    QModelIndexList newIndexes;
+    newIndexes.reserve(oldIndexes.count());
+    for (const auto& oldIndex : oldIndexes) {
+        newIndexes.append(index(rowMap.at(oldIndex.row()), 0));
+    }
+    changePersistentIndexList(oldIndexes, newIndexes);
+    m_files = files;
+
+    emit layoutChanged();
+    return true;
 }
 
 void FileModel::workerErrorOccurred(QString message)
 {
+    m_streamed = false;
     m_errorMessage = message;
     clearModel();
     emit errorMessageChanged();
@@ -453,47 +740,78 @@ void FileModel::workerErrorOccurred(QString message)
     setBusy(false, false);
 }
 
-void FileModel::workerAddedEntry(int index, StatFileInfo file)
-{
-    beginInsertRows(QModelIndex(), index, index);
-    m_files.insert(index, file);
-    endInsertRows();
-
-    emit fileCountChanged();
-    updateFileCounts();
-}
-
-void FileModel::workerRemovedEntry(int index, StatFileInfo file)
+void FileModel::workerFoundChanges(EntryTable files, EntryDiff diff)
 {
-    if (m_files.at(index).absoluteFilePath() != file.absoluteFilePath()) {
+    if (m_files.count() != diff.oldCount()) {
         // this case should not be possible
-        auto path = file.absoluteFilePath();
-        bool found = false;
-        for (int i = 0; i < m_files.count(); i++) {
-            if (m_files.at(index).absoluteFilePath() != path) {
-                found = true;
-                index = 0;
-                break;
+        qDebug() << "[FileModel] warning: worker found changes for outdated entries";
+        beginResetModel();
+        m_files = files;
+        endResetModel();
+        emit fileCountChanged();
+        updateFileCounts();
+        return;
+    }
+
+    for (const auto& op : diff.operations()) {
+        const int last = op.first + op.count - 1;
+
+        switch (op.type) {
+        case EntryDiff::Operation::Remove:
+            beginRemoveRows(QModelIndex(), op.first, last);
+            m_files.removeRows(op.first, op.count);
+            endRemoveRows();
+            break;
+
+        case EntryDiff::Operation::Move:
+            beginMoveRows(QModelIndex(), op.first, last, QModelIndex(), op.target);
+            m_files.moveRows(op.first, op.count, op.target);
+            endMoveRows();
+            break;
+
+        case EntryDiff::Operation::Insert:
+            beginInsertRows(QModelIndex(), op.first, last);
+            m_files.insertRows(op.first, files, op.target, op.count);
+            endInsertRows();
+            break;
+
+        case EntryDiff::Operation::Change:
+            // renamed or modified entries keep their selection
+            for (int i = 0; i < op.count; ++i) {
+                m_files.replaceRow(op.first + i, files, op.target + i);
             }
-        }
-        if (!found) {
-            qDebug() << "[FileModel] error: worker removed entry with invalid index";
-            return;
-        } else {
-            qDebug() << "[FileModel] warning: worker removed entry with shifted index";
+            emit dataChanged(index(op.first, 0), index(last, 0));
+            break;
         }
     }
 
-    beginRemoveRows(QModelIndex(), index, index);
-    m_files.removeAt(index);
-    endRemoveRows();
-
-    emit fileCountChanged();
+    if (diff.oldCount() != diff.newCount()) emit fileCountChanged();
     updateFileCounts();
 }
 
 void FileModel::doUpdateAllEntries()
 {
+    m_streamed = false;
+
+    EntryTable cached;
+    if (!m_dir.isEmpty() && DirectoryCache::instance()->peek(
+                m_dir, FileModelWorker::viewSignature(m_dir, m_filterString, m_settings), cached)) {
+        // Show the last known state at once. The worker checks
+        // in the background whether anything changed since then.
+        // The view is only used if it was made with the current settings.
+        beginResetModel();
+        m_files = cached;
+        m_files.updateDisplayStrings(); // only if outdated
+        endResetModel();
+        emit fileCountChanged();
+        updateFileCounts();
+        applyDoomedEntries(false);
+
+        setBusy(false, true);
+        m_worker->startReadChanged(m_files, m_dir, m_filterString, m_settings);
+        return;
+    }
+
     setBusy(true);
     m_worker->startReadFull(m_dir, m_filterString, m_settings);
 }
@@ -504,14 +822,47 @@ void FileModel::doUpdateChangedEntries()
     m_worker->startReadChanged(m_files, m_dir, m_filterString, m_settings);
 }
 
-void FileModel::updateFileCounts()
+void FileModel::doUpdateEntries(QStringList names)
 {
-    int selectedCount = 0;
+    setBusy(false, true);
+    m_worker->startReadEntries(m_files, names, m_dir, m_filterString, m_settings);
+}
 
-    for (const auto& info : m_files) {
-        if (info.isSelected()) selectedCount++;
+void FileModel::doReprojectEntries()
+{
+    if (m_worker->isRunning()) {
+        // the next refresh uses the new settings as well
+        m_scheduler->addFullRefresh();
+        return;
     }
 
+    setBusy(false, true);
+    m_worker->startReproject(m_files, m_dir, m_filterString, m_settings);
+}
+
+QString FileModel::dirSizeToString(int row) const
+{
+    int size = m_childCounter->count(m_files.absoluteFilePath(row), m_files.device(row),
+                                     m_files.targetInode(row), m_files.lastModifiedNsec(row), row);
+
+    if (size < 0) {
+        // shown while the folder is being counted
+        int estimate = m_files.estimatedDirSize(row);
+        //: at least this many items, the exact number is still being counted
+        if (estimate > 0) return tr("%n+ item(s)", "", estimate);
+        return QStringLiteral("...");
+    }
+
+    //: as in "this folder is empty", but as short as possible
+    if (size == 0) return tr("empty");
+    return tr("%n item(s)", "", size);
+}
+
+void FileModel::updateFileCounts()
+{
+    // counted by the table itself
+    int selectedCount = m_files.selectedCount();
+
     if (m_selectedFileCount != selectedCount) {
         m_selectedFileCount = selectedCount;
         emit selectedFileCountChanged();
@@ -22,12 +22,15 @@
 #ifndef FILEMODEL_H
 #define FILEMODEL_H
 
-#include <functional>
 #include <QAbstractListModel>
 #include <QDir>
-#include <QFileSystemWatcher>
-#include "statfileinfo.h"
+#include <QStringList>
+#include <QTimer>
+#include "entrytable.h"
 #include "filemodelworker.h"
+#include "directorywatcher.h"
+#include "refreshscheduler.h"
+#include "childcounter.h"
 
 class Settings;
 
@@ -88,10 +91,15 @@ public:
     Q_INVOKABLE void markSelectedAsDoomed();
     Q_INVOKABLE void markAsDoomed(QStringList absoluteFilePaths);
 
+    // prefetching directory listings
+    Q_INVOKABLE void prefetch(int fileIndex);
+    Q_INVOKABLE void prefetchWhenIdle();
+    Q_INVOKABLE void cancelPrefetch(bool keepRequested = false);
+
 public slots:
     // reads the directory and inserts/removes model items as needed
     Q_INVOKABLE void refresh();
-    // reads the directory and sets all model items
+    // applies changed view settings, reading the directory only if needed
     Q_INVOKABLE void refreshFull(QString localPath = QString());
 
 signals:
@@ -106,10 +114,17 @@ signals:
 
 private slots:
     void applyFilterString();
-    void workerDone(FileModelWorker::Mode mode, QList<StatFileInfo> files);
+    void workerDone(FileModelWorker::Mode mode, EntryTable files);
+    void workerLoadedBatch(QString dir, EntryTable files, bool first);
     void workerErrorOccurred(QString message);
-    void workerAddedEntry(int index, StatFileInfo file);
-    void workerRemovedEntry(int index, StatFileInfo file);
+    void workerFoundChanges(EntryTable files, EntryDiff diff);
+    void refreshEntries(QStringList names);
+    void childCountReady(QString path, quint64 device, quint64 inode, qint64 modTime, int row, int count);
+    void refreshDisplayStrings();
+    void doomedEntriesChanged(QString directory);
+    void prefetchSubdirectories();
+    void prefetchFinished();
+    void startNextPrefetch();
 
 private:
     /**
@@ -127,8 +142,36 @@ private:
      * This method is called when normally refreshing a view.
      */
     void doUpdateChangedEntries();
-    void doMarkAsDoomed(QList<StatFileInfo>& files, std::function<bool(StatFileInfo&)> checker);
 
+    /**
+     * @brief Rereads only the named entries and updates the model.
+     * This method is called when the watcher reports which entries changed.
+     */
+    void doUpdateEntries(QStringList names);
+
+    /**
+     * @brief Filters and sorts the last listing again and updates the model.
+     * The directory is not read. This method is called when the filter
+     * or the view settings changed.
+     */
+    void doReprojectEntries();
+
+    /**
+     * @brief Marks entries as doomed as listed in the DoomedRegistry.
+     * Registered entries that are not listed anymore are released if
+     * 'releaseMissing' is true.
+     */
+    void applyDoomedEntries(bool releaseMissing);
+
+    /**
+     * @brief Replaces progressively loaded entries by their final sorted list.
+     * Entries are only rearranged, so views keep their position and selection
+     * survives. Returns false if the lists don't match.
+     */
+    bool applyStreamedOrder(EntryTable& files);
+
+    QString dirSizeToString(int row) const;
+    void setRangeSelected(int first, int last, bool selected);
     void updateFileCounts();
     void clearModel();
     void setBusy(bool busy, bool partlyBusy);
@@ -137,16 +180,27 @@ private:
     QString m_dir;
     QString m_filterString = {""};
     QString m_oldFilterString = {""};
-    QList<StatFileInfo> m_files;
+    EntryTable m_files;
     int m_selectedFileCount;
     QString m_errorMessage;
     bool m_active;
-    QFileSystemWatcher *m_watcher;
+    DirectoryWatcher* m_watcher;
+    RefreshScheduler* m_scheduler;
+    ChildCounter* m_childCounter;
     Settings* m_settings;
     FileModelWorker* m_worker;
+    FileModelWorker* m_prefetchWorker;
+    QStringList m_prefetchQueue;
+    bool m_prefetchQueueIdle = {false}; // queue holds only idle prefetches
+    int m_idlePrefetchRow = {-1}; // next row to prefetch while idle, -1 if not prefetching
+    int m_idlePrefetchesLeft = {0};
+    int m_idleChecksLeft = {0};
+    QTimer* m_idlePrefetchTimer;
     FileModelWorker::Mode m_scheduledRefresh = {FileModelWorker::Mode::NoneMode};
     bool m_busy = {false};
     bool m_partlyBusy = {false};
+    bool m_streamed = {false}; // current full listing was loaded in batches
+    bool m_hasDoomed = {false}; // some rows are marked as doomed
 };
 
 #endif // FILEMODEL_H
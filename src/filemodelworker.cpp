@@ -19,17 +19,140 @@
  */
 
 #include <algorithm>
+#include <sys/stat.h>
 #include <QSettings>
+#include <QFile>
 #include <QByteArray>
+#include <QVector>
+#include <QSet>
 #include <QDebug>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QSemaphore>
 #include "filemodelworker.h"
-#include "statfileinfo.h"
+#include "directorylister.h"
+#include "directorycache.h"
 #include "settingshandler.h"
 
+// Partial refreshes needing more ranges of changes are done in full.
 #ifndef FILEMODEL_SIGNAL_THRESHOLD
 #define FILEMODEL_SIGNAL_THRESHOLD 200
 #endif
 
+// Directories with more entries than this are sorted in parallel.
+#ifndef FILEMODEL_PARALLEL_SORT_THRESHOLD
+#define FILEMODEL_PARALLEL_SORT_THRESHOLD 20000
+#endif
+
+// Full listings taking longer than this are shown progressively.
+#ifndef FILEMODEL_FIRST_BATCH_MSEC
+#define FILEMODEL_FIRST_BATCH_MSEC 30
+#endif
+
+// Further batches are sent at most this often to keep the UI responsive.
+#ifndef FILEMODEL_BATCH_INTERVAL_MSEC
+#define FILEMODEL_BATCH_INTERVAL_MSEC 250
+#endif
+
+namespace {
+bool sameDirectoryState(const struct stat& a, const struct stat& b)
+{
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino &&
+            a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+// Builds a key that can be compared with QString::compare(). In natural
+// mode, runs of digits are replaced by a digit marker, the length of the
+// number, and its digits without leading zeros, so that "file9" sorts
+// before "file10" while digits still sort like digits against other
+// characters.
+QString nameSortKey(const QString& name, bool caseSensitive, bool natural)
+{
+    QString folded = caseSensitive ? name : name.toLower();
+    if (!natural) return folded;
+
+    const QChar* data = folded.constData();
+    const int size = folded.size();
+    QString key;
+    key.reserve(size + 8);
+
+    auto isDigit = [data](int i){
+        return data[i].unicode() >= '0' && data[i].unicode() <= '9';
+    };
+
+    for (int i = 0; i < size;) {
+        if (!isDigit(i)) {
+            key.append(data[i]);
+            ++i;
+            continue;
+        }
+
+        int first = i;
+        while (i < size && isDigit(i)) ++i;
+        while (first < i - 1 && data[first].unicode() == '0') ++first;
+
+        key.append(QChar('0'));
+        key.append(QChar(ushort(qMin(i - first, 0xFFFF))));
+        key.append(data + first, i - first);
+    }
+
+    return key;
+}
+
+template<typename T, typename LessThan>
+class SortChunkJob : public QRunnable
+{
+public:
+    SortChunkJob(T* begin, T* end, LessThan lessThan, QSemaphore* done) :
+        m_begin(begin), m_end(end), m_lessThan(lessThan), m_done(done) {
+        setAutoDelete(true);
+    }
+
+    void run() override {
+        std::sort(m_begin, m_end, m_lessThan);
+        m_done->release();
+    }
+
+private:
+    T* m_begin;
+    T* m_end;
+    LessThan m_lessThan;
+    QSemaphore* m_done;
+};
+
+// Sorts chunks of large lists on multiple threads and merges them.
+template<typename T, typename LessThan>
+void parallelSort(QVector<T>& items, LessThan lessThan)
+{
+    const int chunks = qBound(1, QThread::idealThreadCount(), 4);
+    if (items.count() < FILEMODEL_PARALLEL_SORT_THRESHOLD || chunks < 2) {
+        std::sort(items.begin(), items.end(), lessThan);
+        return;
+    }
+
+    T* data = items.data();
+    QVector<int> bounds;
+    for (int k = 0; k <= chunks; ++k) {
+        bounds.append(int(qint64(items.count()) * k / chunks));
+    }
+
+    QSemaphore done;
+    for (int k = 0; k < chunks; ++k) {
+        QThreadPool::globalInstance()->start(new SortChunkJob<T, LessThan>(
+            data + bounds.at(k), data + bounds.at(k+1), lessThan, &done));
+    }
+    done.acquire(chunks);
+
+    for (int width = 1; width < chunks; width *= 2) {
+        for (int k = 0; k + width < chunks; k += 2 * width) {
+            int end = qMin(k + 2 * width, chunks);
+            std::inplace_merge(data + bounds.at(k), data + bounds.at(k + width),
+                               data + bounds.at(end), lessThan);
+        }
+    }
+}
+}
+
 FileModelWorker::FileModelWorker(QObject *parent) : QThread(parent) {
     connect(this, &FileModelWorker::error, this, &FileModelWorker::logError);
     connect(this, &FileModelWorker::alreadyRunning, this,
@@ -51,14 +174,42 @@ void FileModelWorker::cancel()
 void FileModelWorker::startReadFull(QString dir, QString nameFilter, Settings* settings)
 {
     logMessage("note: requested full directory listing");
-    doStartThread(FullMode, {}, dir, nameFilter, settings);
+    doStartThread(FullMode, {}, {}, dir, nameFilter, settings);
 }
 
-void FileModelWorker::startReadChanged(QList<StatFileInfo> oldEntries,
+void FileModelWorker::startReadChanged(EntryTable oldEntries,
                                        QString dir, QString nameFilter, Settings *settings)
 {
     logMessage("note: requested partial directory listing");
-    doStartThread(DiffMode, oldEntries, dir, nameFilter, settings);
+    doStartThread(DiffMode, oldEntries, {}, dir, nameFilter, settings);
+}
+
+void FileModelWorker::startReadEntries(EntryTable oldEntries, QStringList names,
+                                       QString dir, QString nameFilter, Settings *settings)
+{
+    logMessage(QStringLiteral("note: requested update of %1 entries").arg(names.count()));
+    doStartThread(UpdateMode, oldEntries, names, dir, nameFilter, settings);
+}
+
+void FileModelWorker::startReproject(EntryTable oldEntries,
+                                     QString dir, QString nameFilter, Settings *settings)
+{
+    logMessage("note: requested filtering and sorting again");
+    doStartThread(ProjectMode, oldEntries, {}, dir, nameFilter, settings);
+}
+
+void FileModelWorker::startPrefetch(QString dir, Settings* settings, bool idle)
+{
+    logMessage(idle ? "note: requested idle prefetch" : "note: requested prefetch");
+
+    if (isRunning()) {
+        emit alreadyRunning();
+        return;
+    }
+
+    m_idle = idle;
+    m_wasCached = false;
+    doStartThread(PrefetchMode, {}, {}, dir, "", settings);
 }
 
 void FileModelWorker::run()
@@ -76,6 +227,15 @@ void FileModelWorker::run()
     } else if (m_mode == DiffMode) {
         logMessage("note: started with DiffMode");
         doReadDiff();
+    } else if (m_mode == UpdateMode) {
+        logMessage("note: started with UpdateMode");
+        doReadUpdate();
+    } else if (m_mode == ProjectMode) {
+        logMessage("note: started with ProjectMode");
+        doReproject();
+    } else if (m_mode == PrefetchMode) {
+        logMessage("note: started with PrefetchMode");
+        doPrefetch();
     } else if (m_mode == NoneMode) {
         logMessage("note: started with NoneMode");
         return;
@@ -93,7 +253,7 @@ void FileModelWorker::logError(QString message)
     logMessage("error: "+message, false);
 }
 
-void FileModelWorker::doStartThread(FileModelWorker::Mode mode, QList<StatFileInfo> oldEntries,
+void FileModelWorker::doStartThread(FileModelWorker::Mode mode, EntryTable oldEntries, QStringList changedNames,
                                     QString dir, QString nameFilter, Settings* settings)
 {
     if (isRunning()) {
@@ -103,103 +263,131 @@ void FileModelWorker::doStartThread(FileModelWorker::Mode mode, QList<StatFileIn
 
     m_settings = settings;
     m_mode = mode;
-    m_finalEntries = {};
+    m_finalEntries = EntryTable();
     m_oldEntries = oldEntries;
+    m_changedNames = changedNames;
     m_dir = dir;
     m_nameFilter = nameFilter;
+    if (mode != PrefetchMode) m_idle = false;
     m_cancelled.storeRelease(KeepRunning);
-    start();
+    start(m_idle ? QThread::IdlePriority : QThread::InheritPriority);
 }
 
 void FileModelWorker::doReadFull()
 {
-    if (!applySettings()) return; // cancelled
+    if (!applySettings(false)) return; // cancelled
     emit done(m_mode, m_finalEntries);
 }
 
 void FileModelWorker::doReadDiff()
 {
-    if (!applySettings()) return; // cancelled
+    if (!applySettings(false)) return; // cancelled
+    emitChanges();
+}
 
-    // To reduce load on the main UI thread, we abort the process and
-    // instead do a full refresh if there are too many changes.
-    uint signalledChanges = 0;
+void FileModelWorker::doReproject()
+{
+    if (!applySettings(true)) return; // cancelled
+    emitChanges();
+}
 
-    // Algorithm: notify which files were removed, then
-    // notify which files were added.
-    // Complexity without lookup tables: circa 2*O(n^2).
-    // With lookup tables, this gets reduced to around 4*O(n) or even 4*O(1).
-    // This saves multiple seconds in directories with >1000 entries.
+void FileModelWorker::doPrefetch()
+{
+    // Idle prefetches are queued without looking at the cache,
+    // so that the model does not have to check it on the main thread.
+    if (m_idle) {
+        struct stat dirStat;
+        if (stat(QFile::encodeName(m_dir).constData(), &dirStat) == 0
+                && DirectoryCache::instance()->contains(m_dir, dirStat)) {
+            m_wasCached = true;
+            return;
+        }
+    }
 
-    QSet<uint> oldLookup;    QSet<uint> newLookup;
-    QList<uint> oldHashes;   QList<uint> newHashes;
-    /* + m_oldEntries */     QList<StatFileInfo> newEntries = m_finalEntries;
+    // The listing is put into the directory cache, from where it
+    // is taken when the directory is actually opened.
+    if (!applySettings(false)) return; // cancelled
+    logMessage(QStringLiteral("note: prefetched %1 entries").arg(m_finalEntries.count()));
 
-    auto oldEntriesSize = m_oldEntries.size();
-    oldLookup.reserve(oldEntriesSize);
-    oldHashes.reserve(oldEntriesSize);
+    // the cache owns prefetched listings
+    m_rawEntries = EntryTable();
+    m_rawValid = false;
+}
 
-    auto newFileListSize = newEntries.size();
-    newLookup.reserve(newFileListSize);
-    newHashes.reserve(newFileListSize);
+void FileModelWorker::doReadUpdate()
+{
+    if (!readSettings()) return; // cancelled
+    if (!loadListing(true)) return; // cancelled or failed
 
-    if (thresholdAbort(size_t(std::abs(oldEntriesSize-newFileListSize)), newEntries)) {
-        // threshold would be reached, so we can abort immediately
-        return;
-    }
+    struct stat dirStat;
+    bool haveDirStat = (stat(QFile::encodeName(m_dir).constData(), &dirStat) == 0);
 
-    m_finalEntries = m_oldEntries;
-    m_finalEntries.reserve(std::max(oldEntriesSize, newFileListSize));
+    // only the changed entries are stat'ed again
+    DirectoryLister lister(m_dir);
+    lister.setHiddenShown(true);
 
-    // populate new hashes and lookup table
-    // NOTE If necessary we could merge this in the loop
-    // where we initially load the new file list.
-    for (const auto& info : newEntries) {
-        newHashes.append(qHash(info));
-        newLookup.insert(newHashes.last());
+    EntryTable changedEntries;
+    if (!lister.listNames(m_changedNames, changedEntries)) {
         if (cancelIfCancelled()) return;
+        emit error(lister.errorString());
+        return;
     }
 
-    // populate old hashes and lookup table
-    for (const auto& info : m_oldEntries) {
-        oldHashes.append(qHash(info));
-        oldLookup.insert(oldHashes.last());
-    }
+    if (cancelIfCancelled()) return;
 
-    // compare old and new files and do removes if needed
-    // Go from the bottom through all old entries, check if
-    // each entry is anywhere in the new list, emit if not.
-    // After a signal is emitted, all indices higher than the
-    // current one will become invalid.
-    for (int i = m_oldEntries.count()-1; i >= 0; --i) {
-        const StatFileInfo& data = m_oldEntries.at(i);
-        if (!newLookup.contains(oldHashes.at(i))) {
-            if (thresholdAbort(signalledChanges, newEntries)) return;
-            emit entryRemoved(i, data);
-            signalledChanges++;
-            m_finalEntries.removeAt(i);
-            if (cancelIfCancelled()) return;
-        }
-    }
+    // all other entries are taken from the last listing
+    QSet<QString> changedNames;
+    changedNames.reserve(m_changedNames.count());
+    for (const auto& name : m_changedNames) changedNames.insert(name);
 
-    // compare old and new files and do inserts if needed
-    // Go from the top through all new entries, check if
-    // each entry is anywhere in the old list, emit if not.
-    // After a signal is emitted, all indices lower than the
-    // current one will become valid. Higher indices might be
-    // invalid until we checked them.
-    for (int i = 0; i < newEntries.count(); ++i) {
-        const StatFileInfo& data = newEntries.at(i);
-        if (!oldLookup.contains(newHashes.at(i))) {
-            if (thresholdAbort(signalledChanges, newEntries)) return;
-            emit entryAdded(i, data);
-            signalledChanges++;
-            m_finalEntries.insert(i, data);
-            if (cancelIfCancelled()) return;
+    EntryTable merged(m_dir);
+    merged.reserve(m_rawEntries.count() + changedEntries.count());
+    for (int i = 0; i < m_rawEntries.count(); ++i) {
+        if (!changedNames.contains(m_rawEntries.name(i))) {
+            merged.appendRow(m_rawEntries, i);
         }
     }
+    merged.appendRows(changedEntries);
+    merged.clearFlags();
+    merged.updateDisplayStrings();
+
+    sortEntries(merged);
+    if (cancelIfCancelled()) return;
 
+    m_rawEntries = merged;
+    m_rawDirStat = dirStat;
+    m_haveRawDirStat = haveDirStat;
+
+    m_finalEntries = projectEntries(m_rawEntries);
+    cacheListing();
+    emitChanges();
+}
+
+void FileModelWorker::emitChanges()
+{
+    // Changes are collected as ranges of rows and sent all at once.
+    // To reduce load on the main UI thread, we instead do a full
+    // refresh if the changes are too scattered.
+    QElapsedTimer diffTimer;
+    diffTimer.start();
+    EntryDiff diff = EntryDiff::compute(m_oldEntries, m_finalEntries, FILEMODEL_SIGNAL_THRESHOLD);
+    qint64 diffTime = diffTimer.nsecsElapsed();
     if (cancelIfCancelled()) return;
+
+    if (!diff.isValid()) {
+        logMessage("warning: partial refresh reached threshold, upgraded to full");
+        emit done(Mode::FullMode, m_finalEntries);
+        return;
+    }
+
+    logMessage(QStringLiteral("note: %1 removed, %2 added, %3 moved, %4 changed (%5 renamed) in %6 ranges").arg(
+                   diff.removedRows()).arg(diff.insertedRows()).arg(diff.movedRows()).arg(
+                   diff.changedRows()).arg(diff.renamedRows()).arg(diff.operations().count()));
+    logMessage(QStringLiteral("note: compared %1 entries in %2 us (%3 ns per entry)").arg(
+                   m_oldEntries.count() + m_finalEntries.count()).arg(diffTime / 1000).arg(
+                   diffTime / qMax(1, m_oldEntries.count() + m_finalEntries.count())));
+
+    if (!diff.isEmpty()) emit changesFound(m_finalEntries, diff);
     emit done(m_mode, m_finalEntries);
 }
 
@@ -225,147 +413,300 @@ bool FileModelWorker::verifyOrAbort()
     return true;
 }
 
-bool FileModelWorker::applySettings() {
+bool FileModelWorker::readSettings() {
     if (cancelIfCancelled()) return false;
-    bool settingsChanged = false;
-    QFlags<QDir::Filter> newFilters = (QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::System);
-    QFlags<QDir::SortFlag> newSorting;
-    bool sortTime = false;
 
-    // load settings, see SETTINGS.md for details
     if (m_settings) {
-        QString localPath = m_cachedDir.absoluteFilePath(".directory");
-        bool useLocal = m_settings->readVariant("View/UseLocalSettings", true).toBool();
-
-        // filters: show hidden?
-        bool hidden = m_settings->readVariant("View/HiddenFilesShown", false).toBool();
-        if (useLocal) hidden = m_settings->readVariant("Settings/HiddenFilesShown", hidden, localPath).toBool();
-        QDir::Filter hiddenFilter = hidden ? QDir::Hidden : static_cast<QDir::Filter>(0);
-        newFilters |= hiddenFilter;
-
-        // sorting: dirs first?
-        bool dirsFirst = m_settings->readVariant("View/ShowDirectoriesFirst", true).toBool();
-        if (useLocal) dirsFirst = m_settings->readVariant("Sailfish/ShowDirectoriesFirst", dirsFirst, localPath).toBool();
-        if (dirsFirst) newSorting |= QDir::DirsFirst;
-
-        // sorting: sort by...?
-        QString sortSetting = m_settings->readVariant("View/SortRole", "name").toString();
-        if (useLocal) sortSetting = m_settings->readVariant("Dolphin/SortRole", sortSetting, localPath).toString();
-
-        QDir::SortFlag sortBy = QDir::Name;
-        if (sortSetting == "name") {
-            sortBy = QDir::Name;
-        } else if (sortSetting == "size") {
-            sortBy = QDir::Size;
-        } else if (sortSetting == "modificationtime") {
-            // sortBy = QDir::Time; -- no, we sort manually for performance
-            sortTime = true;
-        } else if (sortSetting == "type") {
-            sortBy = QDir::Type;
-        }
-        newSorting |= sortBy;
-
-        // sorting: order reversed?
-        bool orderDefault = m_settings->readVariant("View/SortOrder", "default").toString() == "default";
-        if (useLocal) orderDefault = m_settings->readVariant("Dolphin/SortOrder", 0, localPath) == 0 ? true : false;
-        if (!orderDefault) newSorting |= QDir::Reversed;
-
-        // sorting: ignore case?
-        bool caseSensitive = m_settings->readVariant("View/SortCaseSensitively", false).toBool();
-        if (useLocal) caseSensitive = m_settings->readVariant("Sailfish/SortCaseSensitively", caseSensitive, localPath).toBool();
-        if (!caseSensitive) newSorting |= QDir::IgnoreCase;
+        m_view = readViewSettings(m_cachedDir, m_settings);
     } else {
         logMessage("error: invalid settings object");
     }
 
-    if (m_cachedDir.filter() != newFilters) {
-        m_cachedDir.setFilter(newFilters);
-        settingsChanged = true;
-        if (cancelIfCancelled()) return false;
-    }
+    m_filter.setHiddenShown(m_view.hiddenShown);
+    m_filter.setNameFilter(m_nameFilter);
 
-    if (m_cachedDir.sorting() != newSorting ||
-            m_cachedSortTime != sortTime) {
-        m_cachedDir.setSorting(newSorting);
-        m_cachedSortTime = sortTime;
-        settingsChanged = true;
-        if (cancelIfCancelled()) return false;
-    }
+    return !cancelIfCancelled();
+}
 
-     QString nameFilter = "*"+m_nameFilter+"*";
-     if (m_cachedDir.nameFilters().first() != nameFilter) {
-         m_cachedDir.setNameFilters({nameFilter});
-         settingsChanged = true;
-         logMessage("note: applied name filter '"+nameFilter+"'");
-         if (cancelIfCancelled()) return false;
-     }
-
-    if (!settingsChanged) {
-        // this happens e.g. when deleting or renaming files
-        m_cachedDir.refresh();
+FileModelWorker::ViewSettings FileModelWorker::readViewSettings(const QDir& dir, Settings* settings)
+{
+    // load settings, see SETTINGS.md for details
+    ViewSettings view;
+    QString localPath = dir.absoluteFilePath(".directory");
+    bool useLocal = settings->readVariant("View/UseLocalSettings", true).toBool();
+
+    // filters: show hidden?
+    bool hidden = settings->readVariant("View/HiddenFilesShown", false).toBool();
+    if (useLocal) hidden = settings->readVariant("Settings/HiddenFilesShown", hidden, localPath).toBool();
+    view.hiddenShown = hidden;
+
+    // sorting: dirs first?
+    bool dirsFirst = settings->readVariant("View/ShowDirectoriesFirst", true).toBool();
+    if (useLocal) dirsFirst = settings->readVariant("Sailfish/ShowDirectoriesFirst", dirsFirst, localPath).toBool();
+    view.dirsFirst = dirsFirst;
+
+    // sorting: sort by...?
+    QString sortSetting = settings->readVariant("View/SortRole", "name").toString();
+    if (useLocal) sortSetting = settings->readVariant("Dolphin/SortRole", sortSetting, localPath).toString();
+
+    if (sortSetting == "name") {
+        view.sortRole = SortRole::Name;
+    } else if (sortSetting == "size") {
+        view.sortRole = SortRole::Size;
+    } else if (sortSetting == "modificationtime") {
+        view.sortRole = SortRole::ModificationTime;
+    } else if (sortSetting == "type") {
+        view.sortRole = SortRole::Type;
+    } else if (sortSetting == "natural") {
+        view.sortRole = SortRole::Natural;
+    } else {
+        view.sortRole = SortRole::Name;
     }
 
-    // load entries
-    QStringList fileList = m_cachedDir.entryList();
-    m_finalEntries.clear();
-    m_finalEntries.reserve(fileList.size());
-    int dirsCount = 0;
-    for (const auto& filename : fileList) {
-        m_finalEntries.append(StatFileInfo(m_cachedDir.absoluteFilePath(filename)));
-        if (m_finalEntries.last().isDirAtEnd()) dirsCount++;
+    // sorting: order reversed?
+    bool orderDefault = settings->readVariant("View/SortOrder", "default").toString() == "default";
+    if (useLocal) orderDefault = settings->readVariant("Dolphin/SortOrder", 0, localPath) == 0 ? true : false;
+    view.sortReversed = !orderDefault;
+
+    // sorting: ignore case?
+    bool caseSensitive = settings->readVariant("View/SortCaseSensitively", false).toBool();
+    if (useLocal) caseSensitive = settings->readVariant("Sailfish/SortCaseSensitively", caseSensitive, localPath).toBool();
+    view.sortCaseSensitive = caseSensitive;
+
+    return view;
+}
+
+bool FileModelWorker::applySettings(bool reuseListing) {
+    if (!readSettings()) return false;
+    if (!loadListing(reuseListing)) return false;
+
+    QElapsedTimer timer;
+    timer.start();
+    m_finalEntries = projectEntries(m_rawEntries);
+    logMessage(QStringLiteral("note: filtered %1 of %2 entries in %3 us").arg(
+                   m_finalEntries.count()).arg(m_rawEntries.count()).arg(timer.nsecsElapsed() / 1000));
+
+    cacheListing();
+    return !cancelIfCancelled();
+}
+
+bool FileModelWorker::loadListing(bool reuseListing)
+{
+    // The last listing is used without checking the directory if
+    // 'reuseListing' is set. Otherwise it is only used if the directory
+    // did not change since it was read, and the directory cache is
+    // checked before actually reading the directory.
+    bool sameDir = m_rawValid && m_rawDir == m_dir;
+
+    if (reuseListing && sameDir) {
+        logMessage("note: using last listing");
+    } else {
+        // The directory is stat'ed before it is read, so that changes made
+        // while reading it invalidate the listing.
+        struct stat dirStat;
+        bool haveDirStat = (stat(QFile::encodeName(m_dir).constData(), &dirStat) == 0);
+
+        if (sameDir && haveDirStat && m_haveRawDirStat && sameDirectoryState(m_rawDirStat, dirStat)) {
+            logMessage("note: directory unchanged, using last listing");
+        } else if (haveDirStat && DirectoryCache::instance()->find(
+                       m_dir, dirStat, m_rawEntries, m_rawSortSignature)) {
+            logMessage(QStringLiteral("note: using cached listing (%1 hits, %2 misses)").arg(
+                           DirectoryCache::instance()->hits()).arg(DirectoryCache::instance()->misses()));
+        } else {
+            // Hidden and filtered entries are listed as well, so that
+            // changing the filter later does not require any I/O.
+            m_rawValid = false;
+            m_rawSortSignature = "";
+            DirectoryLister lister(m_dir);
+            lister.setHiddenShown(true);
+
+            m_streamedCount = 0;
+            m_lastBatchTime = 0;
+            m_batchTimer.start();
+
+            auto checkpoint = [&](const EntryTable& entries) -> bool {
+                if (m_cancelled.loadAcquire() == Cancelled) return false;
+                streamBatch(entries);
+                return true;
+            };
+
+            if (!lister.list(m_rawEntries, checkpoint)) {
+                m_rawEntries = EntryTable();
+                if (cancelIfCancelled()) return false;
+                emit error(lister.errorString());
+                return false;
+            }
+
+            // entries listed after the last batch, so that the model
+            // has all of them when the sorted listing is merged
+            streamBatch(m_rawEntries, true);
+
+            logMessage(QStringLiteral("note: listed %1 entries using about %2 KiB").arg(
+                           m_rawEntries.count()).arg(m_rawEntries.estimatedMemoryUsage() / 1024));
+        }
+
+        m_rawDir = m_dir;
+        m_rawDirStat = dirStat;
+        m_haveRawDirStat = haveDirStat;
+        m_rawValid = true;
     }
 
     if (cancelIfCancelled()) return false;
 
-    // apply manual sorting
-    if (!newSorting.testFlag(QDir::DirsFirst)) {
-        dirsCount = -1; // don't sort dirs separately
+    // the listing is only sorted again if the order changed
+    QString signature = sortSignature(m_view);
+    if (m_rawSortSignature != signature) {
+        sortEntries(m_rawEntries);
+        if (cancelIfCancelled()) return false;
+        m_rawSortSignature = signature;
     }
 
-    if (sortTime) {
-        sortByModTime(m_finalEntries,
-                      newSorting.testFlag(QDir::Reversed),
-                      dirsCount);
-    }
+    // only new entries need their display strings
+    m_rawEntries.updateDisplayStrings();
+    return !cancelIfCancelled();
+}
 
-    return true;
+void FileModelWorker::cacheListing()
+{
+    if (!m_haveRawDirStat) return;
+    DirectoryCache::instance()->insert(m_dir, m_rawDirStat, m_rawEntries, m_rawSortSignature,
+                                       m_finalEntries, viewSignature(m_view, m_nameFilter));
 }
 
-bool FileModelWorker::thresholdAbort(size_t currentChanges, const QList<StatFileInfo>& fullFiles)
+EntryTable FileModelWorker::projectEntries(const EntryTable& entries) const
 {
-    const size_t signalThreshold = FILEMODEL_SIGNAL_THRESHOLD;
-    if (currentChanges >= signalThreshold) {
-        logMessage("warning: partial refresh reached threshold, upgraded to full");
-        emit done(Mode::FullMode, fullFiles);
-        return true;
+    // The listing is already sorted, so filtering keeps the order.
+    if (m_filter.acceptsAll()) return entries;
+
+    EntryTable view(m_dir);
+    view.reserve(entries.count());
+    for (int i = 0; i < entries.count(); ++i) {
+        if (m_filter.accepts(entries.name(i))) view.appendRow(entries, i);
     }
-    return false;
+    return view;
+}
+
+QString FileModelWorker::sortSignature(const ViewSettings& view)
+{
+    // all settings that change the order of the listing
+    return QStringLiteral("%1|%2|%3|%4").arg(
+                view.dirsFirst).arg(int(view.sortRole)).arg(
+                view.sortReversed).arg(view.sortCaseSensitive);
 }
 
-void FileModelWorker::sortByModTime(QList<StatFileInfo> &files, bool reverse, int dirsFirstCount)
+QString FileModelWorker::viewSignature(const ViewSettings& view, const QString& nameFilter)
 {
-#define COMP_LAMBDA [&](const StatFileInfo& a, const StatFileInfo& b) -> bool
-    auto doSort = COMP_LAMBDA {
+    // all settings that change which entries are shown and their order
+    return QStringLiteral("%1|%2|%3").arg(sortSignature(view)).arg(view.hiddenShown).arg(nameFilter);
+}
+
+QString FileModelWorker::viewSignature(QString dir, QString nameFilter, Settings* settings)
+{
+    ViewSettings view;
+    if (settings) view = readViewSettings(QDir(dir), settings);
+    return viewSignature(view, nameFilter);
+}
+
+void FileModelWorker::sortEntries(EntryTable &files)
+{
+    // Sort keys are prepared once per entry so the comparison
+    // itself never has to allocate. Except for natural sorting, the
+    // order matches what QDir used to produce with the same settings.
+    struct SortItem {
+        QString name;
+        QString suffix;
+        qint64 size;
+        qint64 modTime;
+        bool isDir;
+        int index;
+    };
+
+    QVector<SortItem> items;
+    items.reserve(files.count());
+
+    for (int i = 0; i < files.count(); ++i) {
+        SortItem item;
+        item.name = nameSortKey(files.name(i), m_view.sortCaseSensitive, m_view.sortRole == SortRole::Natural);
+        if (m_view.sortRole == SortRole::Type) {
+            item.suffix = m_view.sortCaseSensitive ? files.suffix(i) : files.suffix(i).toLower();
+        }
+        item.size = files.size(i);
+        item.modTime = files.lastModifiedStat(i);
+        item.isDir = files.isDirAtEnd(i);
+        item.index = i;
+        items.append(item);
+    }
+
+    if (cancelIfCancelled()) return;
+
+    auto lessThan = [&](const SortItem& a, const SortItem& b) -> bool {
         // return true if a comes before b
-        if (!reverse /* == default*/) {
-            // STL sorts ascending (using operator<) by default.
+        // Folders stay on top even when the order is reversed.
+        if (m_view.dirsFirst && a.isDir != b.isDir) return a.isDir;
+
+        int r = 0;
+        switch (m_view.sortRole) {
+        case SortRole::ModificationTime:
             // We want newer dates first by default, i.e. descending.
-            return a.lastModifiedStat() > b.lastModifiedStat();
-        } else /* == reverse*/ {
-            return a.lastModifiedStat() < b.lastModifiedStat();
+            r = (a.modTime > b.modTime) ? -1 : (a.modTime < b.modTime ? 1 : 0);
+            break;
+        case SortRole::Size:
+            // larger files first
+            r = (a.size > b.size) ? -1 : (a.size < b.size ? 1 : 0);
+            break;
+        case SortRole::Type:
+            r = a.suffix.compare(b.suffix);
+            break;
+        case SortRole::Name:
+        case SortRole::Natural:
+            break;
         }
+
+        // still not sorted: sort by name
+        if (r == 0) r = a.name.compare(b.name);
+        // keys can be equal for different names, e.g. "a" and "A"
+        if (r == 0) r = files.name(a.index).compare(files.name(b.index));
+        return m_view.sortReversed ? r > 0 : r < 0;
     };
 
-    if (dirsFirstCount > 0) {
-        // QDir placed dirs already at the beginning, so we can just sort
-        // two ranges (dirs and files).
-        std::sort(files.begin(), files.begin()+dirsFirstCount-1, doSort);
-        std::sort(files.begin()+dirsFirstCount, files.end(), doSort);
-    } else {
-        // we sort everything at once without taking care of dirs
-        std::sort(files.begin(), files.end(), doSort);
+    parallelSort(items, lessThan);
+
+    QVector<int> order;
+    order.reserve(items.count());
+    for (const auto& item : items) {
+        order.append(item.index);
     }
-#undef COMP_LAMBDA
+    files = files.reordered(order);
+}
+
+void FileModelWorker::streamBatch(const EntryTable& entries, bool force)
+{
+    // Only full listings are streamed. Partial refreshes
+    // keep showing the current entries until they are done.
+    if (m_mode != FullMode) return;
+
+    qint64 elapsed = m_batchTimer.elapsed();
+    if (force) {
+        // the rest of a listing that is already being streamed
+        if (m_streamedCount == 0) return;
+    } else if (m_streamedCount == 0) {
+        if (elapsed < FILEMODEL_FIRST_BATCH_MSEC) return;
+    } else if (elapsed - m_lastBatchTime < FILEMODEL_BATCH_INTERVAL_MSEC) {
+        return;
+    }
+
+    if (entries.count() <= m_streamedCount) return;
+
+    // Each batch is filtered and sorted on its own. The final sorted
+    // list is sent with done() and merged into the model without a reset.
+    EntryTable batch = projectEntries(entries.mid(m_streamedCount));
+    if (batch.isEmpty()) return;
+    sortEntries(batch);
+    batch.updateDisplayStrings();
+    emit batchLoaded(m_dir, batch, m_streamedCount == 0);
+
+    m_streamedCount = entries.count();
+    m_lastBatchTime = elapsed;
 }
 
 bool FileModelWorker::cancelIfCancelled()
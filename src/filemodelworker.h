@@ -21,15 +21,23 @@
 #ifndef FILEMODELWORKER_H
 #define FILEMODELWORKER_H
 
+#include <sys/stat.h>
 #include <QThread>
+#include <QElapsedTimer>
 #include <QDir>
-#include <QList>
-#include "statfileinfo.h"
+#include <QStringList>
+#include "entrytable.h"
+#include "entrydiff.h"
+#include "entryfilter.h"
 
 class Settings;
 
 /**
  * @brief This class loads filtered and sorted directory listings.
+ *
+ * The unfiltered listing of the last directory is kept in memory, so
+ * that changing the filter or the sorting only has to filter and sort
+ * it again, without reading the directory.
  */
 class FileModelWorker : public QThread
 {
@@ -38,9 +46,26 @@ class FileModelWorker : public QThread
         Cancelled = 0, KeepRunning = 1
     };
 
+    enum class SortRole {
+        Name, Size, ModificationTime, Type,
+        Natural // by name, with numbers ordered by value
+    };
+
+    // hidden files and sorting settings that apply to a directory
+    struct ViewSettings {
+        bool hiddenShown = {false};
+        bool dirsFirst = {true};
+        bool sortReversed = {false};
+        bool sortCaseSensitive = {false};
+        SortRole sortRole = {SortRole::Name};
+    };
+
 public:
     enum Mode {
-        NoneMode, FullMode, DiffMode
+        NoneMode, FullMode, DiffMode,
+        UpdateMode, // like DiffMode, but only named entries are checked
+        PrefetchMode, // only fills the directory cache
+        ProjectMode // like DiffMode, but only filters and sorts the last listing again
     };
 
     explicit FileModelWorker(QObject *parent = nullptr);
@@ -49,17 +74,36 @@ public:
 
     // call to start the thread
     void startReadFull(QString dir, QString nameFilter, Settings* settings);
-    void startReadChanged(QList<StatFileInfo> oldEntries,
+    void startReadChanged(EntryTable oldEntries,
+                          QString dir, QString nameFilter, Settings* settings);
+    void startReadEntries(EntryTable oldEntries, QStringList names,
                           QString dir, QString nameFilter, Settings* settings);
+    void startReproject(EntryTable oldEntries,
+                        QString dir, QString nameFilter, Settings* settings);
+    // idle prefetches run with the lowest thread priority
+    void startPrefetch(QString dir, Settings* settings, bool idle);
+    bool isIdlePrefetch() const { return m_mode == PrefetchMode && m_idle; }
+
+    // Describes the hidden files, name filter and sorting settings that
+    // currently apply to 'dir'. Cached views are stored with the signature
+    // they were made with. Reads the settings, but not the directory.
+    static QString viewSignature(QString dir, QString nameFilter, Settings* settings);
+    // true if the last idle prefetch found a valid listing in the cache
+    bool wasCached() const { return m_wasCached; }
 
 signals:
     // one of these is emitted when thread ends
-    void done(FileModelWorker::Mode mode, QList<StatFileInfo> entries);
+    void done(FileModelWorker::Mode mode, EntryTable entries);
     void error(QString message);
     void alreadyRunning();
 
-    void entryAdded(int index, StatFileInfo file);
-    void entryRemoved(int index, StatFileInfo file);
+    // emitted while a full listing is still running to
+    // show the first entries of very large folders early
+    void batchLoaded(QString dir, EntryTable entries, bool first);
+
+    // emitted before done() in DiffMode, UpdateMode, and ProjectMode, 'diff' describes how to
+    // get from the old listing to 'entries'
+    void changesFound(EntryTable entries, EntryDiff diff);
 
 protected:
     void run() override;
@@ -69,27 +113,55 @@ private slots:
     void logMessage(QString message, bool markSilent = true);
 
 private:
-    void doStartThread(Mode mode, QList<StatFileInfo> oldEntries,
+    void doStartThread(Mode mode, EntryTable oldEntries, QStringList changedNames,
                        QString dir, QString nameFilter, Settings* settings);
     void doReadFull();
     void doReadDiff();
+    void doReadUpdate();
+    void doPrefetch();
+    void doReproject();
+    void emitChanges();
 
     bool verifyOrAbort();
-    bool applySettings();
-    bool thresholdAbort(size_t currentChanges, const QList<StatFileInfo> &fullFiles);
-    void sortByModTime(QList<StatFileInfo>& files, bool reverse, int dirsFirstCount);
+    bool readSettings();
+    static ViewSettings readViewSettings(const QDir& dir, Settings* settings);
+    static QString sortSignature(const ViewSettings& view);
+    static QString viewSignature(const ViewSettings& view, const QString& nameFilter);
+    bool applySettings(bool reuseListing);
+    bool loadListing(bool reuseListing);
+    void cacheListing();
+    EntryTable projectEntries(const EntryTable& entries) const;
+    void sortEntries(EntryTable& files);
+    // sends new entries to the model, force sends them without throttling
+    void streamBatch(const EntryTable& entries, bool force = false);
 
     // returns true if cancelled and emits an error
     bool cancelIfCancelled();
 
     QDir m_cachedDir = {""};
-    bool m_cachedSortTime = {false};
+    ViewSettings m_view;
     Settings* m_settings = {nullptr};
     FileModelWorker::Mode m_mode = {FullMode};
-    QList<StatFileInfo> m_finalEntries = {};
-    QList<StatFileInfo> m_oldEntries;
+    bool m_idle = {false};
+    bool m_wasCached = {false};
+    EntryFilter m_filter;
+    EntryTable m_finalEntries;
+    EntryTable m_oldEntries;
+    QStringList m_changedNames;
     QString m_dir = {""};
     QString m_nameFilter = {""};
+    QElapsedTimer m_batchTimer;
+    qint64 m_lastBatchTime = {0};
+    int m_streamedCount = {0};
+
+    // unfiltered listing, sorted as described by m_rawSortSignature
+    EntryTable m_rawEntries;
+    QString m_rawDir = {""};
+    QString m_rawSortSignature = {""};
+    struct stat m_rawDirStat;
+    bool m_haveRawDirStat = {false};
+    bool m_rawValid = {false};
+
     QAtomicInt m_cancelled = {KeepRunning}; // atomic so no locks needed
 };
 
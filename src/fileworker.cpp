@@ -21,8 +21,83 @@
  */
 
 #include "fileworker.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <QDateTime>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
 #include "globals.h"
+#include "filecopier.h"
+#include "transferplan.h"
+
+// Minimum interval between progress reports while copying.
+#ifndef FILEWORKER_REPORT_INTERVAL_MSEC
+#define FILEWORKER_REPORT_INTERVAL_MSEC 250
+#endif
+
+// Files up to this size are copied in parallel, larger files
+// are limited by bandwidth and copied one after another.
+#ifndef FILEWORKER_SMALL_FILE_SIZE
+#define FILEWORKER_SMALL_FILE_SIZE (1024*1024)
+#endif
+
+// Threads copying small files. Each keeps a source and a destination
+// file open. Large files are copied by the worker thread itself at the
+// same time, so up to this number plus one pair of files are open.
+#ifndef FILEWORKER_COPY_THREADS
+#define FILEWORKER_COPY_THREADS 4
+#endif
+
+// Small files that are waiting to be copied.
+#ifndef FILEWORKER_QUEUED_COPIES
+#define FILEWORKER_QUEUED_COPIES 256
+#endif
+
+// Interval of checks for cancelling while the queue of small files is full.
+#ifndef FILEWORKER_QUEUE_WAIT_MSEC
+#define FILEWORKER_QUEUE_WAIT_MSEC 100
+#endif
+
+// Bytes copied between records of the offset in the journal.
+#ifndef FILEWORKER_JOURNAL_STEP
+#define FILEWORKER_JOURNAL_STEP (16*1024*1024)
+#endif
+
+namespace {
+class FileCopyJob : public QRunnable
+{
+public:
+    explicit FileCopyJob(std::function<void()> job) : m_job(job) {}
+    void run() Q_DECL_OVERRIDE { m_job(); }
+
+private:
+    std::function<void()> m_job;
+};
+}
+
+// returns the sources that are not on the file system of the destination
+static QStringList crossDeviceFiles(const QStringList& filenames, const QString& destDirectory)
+{
+    struct stat destStat;
+    if (stat(QFile::encodeName(destDirectory).constData(), &destStat) != 0) {
+        return filenames;
+    }
+
+    QStringList result;
+    for (const auto& filename : filenames) {
+        struct stat data;
+        if (lstat(QFile::encodeName(filename).constData(), &data) != 0 || data.st_dev != destStat.st_dev) {
+            result.append(filename);
+        }
+    }
+
+    return result;
+}
 
 // creates a "Document (2)" numbered name from the given filename
 static QString createNumberedFilename(QString filename)
@@ -62,8 +137,12 @@ FileWorker::FileWorker(QObject *parent) :
     QThread(parent),
     m_mode(DeleteMode),
     m_cancelled(KeepRunning),
-    m_progress(0)
+    m_progress(0),
+    m_paused(0),
+    m_interrupted(0),
+    m_queuedCopies(FILEWORKER_QUEUED_COPIES)
 {
+    m_copyPool.setMaxThreadCount(FILEWORKER_COPY_THREADS);
 }
 
 FileWorker::~FileWorker()
@@ -83,6 +162,8 @@ void FileWorker::startDeleteFiles(QStringList filenames)
     m_mode = DeleteMode;
     m_filenames = filenames;
     m_cancelled.storeRelease(KeepRunning);
+    m_paused.storeRelease(0);
+    m_interrupted.storeRelease(0);
     start();
 }
 
@@ -100,6 +181,8 @@ void FileWorker::startCopyFiles(QStringList filenames, QString destDirectory)
     m_filenames = filenames;
     m_destDirectory = destDirectory;
     m_cancelled.storeRelease(KeepRunning);
+    m_paused.storeRelease(0);
+    m_interrupted.storeRelease(0);
     start();
 }
 
@@ -117,6 +200,8 @@ void FileWorker::startMoveFiles(QStringList filenames, QString destDirectory)
     m_filenames = filenames;
     m_destDirectory = destDirectory;
     m_cancelled.storeRelease(KeepRunning);
+    m_paused.storeRelease(0);
+    m_interrupted.storeRelease(0);
     start();
 }
 
@@ -134,12 +219,210 @@ void FileWorker::startSymlinkFiles(QStringList filenames, QString destDirectory)
     m_filenames = filenames;
     m_destDirectory = destDirectory;
     m_cancelled.storeRelease(KeepRunning);
+    m_paused.storeRelease(0);
+    m_interrupted.storeRelease(0);
+    start();
+}
+
+void FileWorker::startResumeTransfer()
+{
+    if (isRunning()) {
+        emit errorOccurred(tr("File operation already in progress"), "");
+        return;
+    }
+
+    // the journal is read on the worker thread
+    m_mode = ResumeMode;
+    m_cancelled.storeRelease(KeepRunning);
+    m_paused.storeRelease(0);
+    m_interrupted.storeRelease(0);
     start();
 }
 
+void FileWorker::interrupt()
+{
+    m_interrupted.storeRelease(1);
+    cancel();
+}
+
 void FileWorker::cancel()
 {
     m_cancelled.storeRelease(Cancelled);
+
+    // wake up a paused worker so that it can stop
+    QMutexLocker locker(&m_pauseMutex);
+    m_pauseCondition.wakeAll();
+}
+
+void FileWorker::pause()
+{
+    m_paused.storeRelease(1);
+}
+
+void FileWorker::resume()
+{
+    QMutexLocker locker(&m_pauseMutex);
+    m_paused.storeRelease(0);
+    m_pauseCondition.wakeAll();
+}
+
+bool FileWorker::waitIfPaused()
+{
+    if (m_paused.loadAcquire() != 0 && m_cancelled.loadAcquire() != Cancelled) {
+        {
+            QMutexLocker locker(&m_transferMutex);
+            if (m_bytesTotal >= 0) {
+                emit transferProgressChanged(m_bytesDone, m_bytesTotal, 0, -1, m_filesDone, 0);
+            }
+        }
+
+        QMutexLocker locker(&m_pauseMutex);
+        while (m_paused.loadAcquire() != 0 && m_cancelled.loadAcquire() != Cancelled) {
+            m_pauseCondition.wait(&m_pauseMutex);
+        }
+        locker.unlock();
+
+        // the pause does not count for the throughput
+        QMutexLocker transferLocker(&m_transferMutex);
+        m_reportTimer.restart();
+        m_bytesAtLastReport = m_bytesDone;
+        m_filesAtLastReport = m_filesDone;
+    }
+
+    return m_cancelled.loadAcquire() == Cancelled;
+}
+
+void FileWorker::startTransfer(qint64 bytesTotal)
+{
+    QMutexLocker locker(&m_transferMutex);
+    m_bytesDone = 0;
+    m_bytesTotal = bytesTotal;
+    m_bytesAtLastReport = 0;
+    m_bytesPerSecond = 0;
+    m_filesDone = 0;
+    m_filesAtLastReport = 0;
+    m_filesPerSecond = 0;
+    m_reportTimer.start();
+    reportTransfer(true);
+}
+
+void FileWorker::setCurrentFile(const QString& filename, bool force)
+{
+    QMutexLocker locker(&m_transferMutex);
+    m_currentFile = filename;
+    reportTransfer(force);
+}
+
+void FileWorker::addTransferredBytes(qint64 bytes)
+{
+    QMutexLocker locker(&m_transferMutex);
+    m_bytesDone += bytes;
+    reportTransfer(false);
+}
+
+void FileWorker::addTransferredFile()
+{
+    QMutexLocker locker(&m_transferMutex);
+    ++m_filesDone;
+    reportTransfer(false);
+}
+
+void FileWorker::reportTransfer(bool force)
+{
+    qint64 elapsed = m_reportTimer.elapsed();
+    if (!force && elapsed < FILEWORKER_REPORT_INTERVAL_MSEC) return;
+
+    if (elapsed >= FILEWORKER_REPORT_INTERVAL_MSEC) {
+        // smoothed, so that the estimate does not jump around
+        double bytesRate = 1000.0 * (m_bytesDone - m_bytesAtLastReport) / elapsed;
+        double filesRate = 1000.0 * (m_filesDone - m_filesAtLastReport) / elapsed;
+        m_bytesPerSecond = m_bytesPerSecond > 0 ? 0.7 * m_bytesPerSecond + 0.3 * bytesRate : bytesRate;
+        m_filesPerSecond = m_filesPerSecond > 0 ? 0.7 * m_filesPerSecond + 0.3 * filesRate : filesRate;
+        m_bytesAtLastReport = m_bytesDone;
+        m_filesAtLastReport = m_filesDone;
+        m_reportTimer.restart();
+    }
+
+    qint64 remaining = -1;
+    if (m_bytesTotal > 0) {
+        // files may grow while they are copied
+        m_progress = int(qBound(Q_INT64_C(0), 100 * m_bytesDone / m_bytesTotal, Q_INT64_C(100)));
+
+        if (m_bytesPerSecond > 0) {
+            remaining = qint64(qMax(Q_INT64_C(0), m_bytesTotal - m_bytesDone) / m_bytesPerSecond);
+        }
+    }
+
+    emit progressChanged(m_progress, m_currentFile);
+    emit transferProgressChanged(m_bytesDone, m_bytesTotal, qint64(m_bytesPerSecond), remaining,
+                                 m_filesDone, int(m_filesPerSecond + 0.5));
+}
+
+void FileWorker::queueCopy(const QString& src, const QString& dest, QSharedPointer<PendingFolder> folder)
+{
+    // Limits the number of pending jobs and thus memory. While waiting
+    // for a free slot, the transfer can still be paused or cancelled.
+    while (!m_queuedCopies.tryAcquire(1, FILEWORKER_QUEUE_WAIT_MSEC)) {
+        if (waitIfPaused()) {
+            // the file is missing, so the folder must not count as copied
+            QMutexLocker locker(&m_transferMutex);
+            if (m_queuedCopyError.isEmpty()) m_queuedCopyError = tr("Cancelled");
+            return;
+        }
+    }
+
+    folder->pending.ref();
+
+    m_copyPool.start(new FileCopyJob([this, src, dest, folder](){
+        if (queuedCopyError().isEmpty()) {
+            // skipped files must not let the folder count as copied
+            QString errmsg = waitIfPaused() ? tr("Cancelled") : copyOverwrite(src, dest);
+
+            if (!errmsg.isEmpty()) {
+                QMutexLocker locker(&m_transferMutex);
+                if (m_queuedCopyError.isEmpty()) m_queuedCopyError = errmsg;
+            } else {
+                addTransferredFile();
+                releaseFolder(folder);
+            }
+        }
+
+        m_queuedCopies.release();
+    }));
+}
+
+void FileWorker::releaseFolder(const QSharedPointer<PendingFolder>& folder)
+{
+    // one record replaces those of all files in the folder
+    if (!folder->pending.deref()) m_journal.setFolderDone(folder->path);
+}
+
+QString FileWorker::queuedCopyError()
+{
+    QMutexLocker locker(&m_transferMutex);
+    return m_queuedCopyError;
+}
+
+QString FileWorker::finishQueuedCopies(const QString& error)
+{
+    if (!error.isEmpty()) {
+        // remaining jobs are skipped
+        QMutexLocker locker(&m_transferMutex);
+        if (m_queuedCopyError.isEmpty()) m_queuedCopyError = error;
+    }
+
+    m_copyPool.waitForDone();
+
+    QMutexLocker locker(&m_transferMutex);
+    QString errmsg = m_queuedCopyError;
+    m_queuedCopyError.clear();
+
+    // jobs that had not started yet when cancelled did nothing
+    if (errmsg.isEmpty() && m_cancelled.loadAcquire() == Cancelled) {
+        errmsg = tr("Cancelled");
+    }
+
+    return errmsg;
 }
 
 void FileWorker::run()
@@ -153,9 +436,33 @@ void FileWorker::run()
         deleteFiles();
         break;
 
+    case ResumeMode:
+        if (!m_journal.load()) {
+            m_journal.finish();
+            emit errorOccurred(tr("Cannot resume the interrupted transfer"), "");
+            break;
+        }
+
+        m_mode = m_journal.mode() == TransferJournal::MoveMode ? MoveMode : CopyMode;
+        m_filenames = m_journal.sources();
+        m_destDirectory = m_journal.destDirectory();
+        m_resuming = true;
+        copyOrMoveFiles();
+        if (m_interrupted.loadAcquire() == 0) m_journal.finish();
+        else m_journal.flush();
+        break;
+
     case MoveMode:
     case CopyMode:
+        m_resuming = false;
+        m_journal.begin(m_mode == MoveMode ? TransferJournal::MoveMode : TransferJournal::CopyMode,
+                        m_filenames, m_destDirectory);
         copyOrMoveFiles();
+
+        // the journal is kept if the app is closed, so that
+        // the transfer can be resumed on the next start
+        if (m_interrupted.loadAcquire() == 0) m_journal.finish();
+        else m_journal.flush();
         break;
     }
 }
@@ -183,7 +490,7 @@ void FileWorker::symlinkFiles()
         emit progressChanged(m_progress, filename);
 
         // stop if cancelled
-        if (m_cancelled.loadAcquire() == Cancelled) {
+        if (waitIfPaused()) {
             emit errorOccurred(tr("Cancelled"), filename);
             return;
         }
@@ -255,7 +562,7 @@ void FileWorker::deleteFiles()
         emit progressChanged(m_progress, filename);
 
         // stop if cancelled
-        if (m_cancelled.loadAcquire() == Cancelled) {
+        if (waitIfPaused()) {
             emit errorOccurred(tr("Cancelled"), filename);
             return;
         }
@@ -281,21 +588,65 @@ void FileWorker::copyOrMoveFiles()
     int fileIndex = 0;
     int fileCount = m_filenames.count();
 
+    // moving within a file system only renames, so only files that are
+    // copied or moved to another file system are planned and report their bytes
+    m_bytesTotal = -1;
+    QStringList planned = m_filenames;
+    if (m_mode == MoveMode) {
+        planned = crossDeviceFiles(m_filenames, m_destDirectory);
+    }
+
+    if (!planned.isEmpty()) {
+        TransferPlan plan;
+        plan.readDestination(m_destDirectory);
+        plan.collect(planned, [this](){ return m_cancelled.loadAcquire() == Cancelled; });
+        emit transferPlanned(plan.toVariantMap());
+
+        if (m_cancelled.loadAcquire() == Cancelled) {
+            emit errorOccurred(tr("Cancelled"), "");
+            return;
+        }
+
+        // fail before anything is written; files of a resumed
+        // transfer may already be there, so they are not checked
+        if (!m_resuming && !plan.hasEnoughSpace()) {
+            emit errorOccurred(tr("Not enough free space: %1 needed, %2 available")
+                               .arg(filesizeToString(plan.bytesNeeded()))
+                               .arg(filesizeToString(plan.bytesAvailable())), m_destDirectory);
+            return;
+        }
+
+        startTransfer(plan.bytes());
+    }
+
     QDir dest(m_destDirectory);
     foreach (QString filename, m_filenames) {
-        m_progress = 100 * fileIndex / fileCount;
-        emit progressChanged(m_progress, filename);
+        if (m_bytesTotal >= 0) {
+            setCurrentFile(filename, true);
+        } else {
+            m_progress = 100 * fileIndex / fileCount;
+            emit progressChanged(m_progress, filename);
+        }
 
         // stop if cancelled
-        if (m_cancelled.loadAcquire() == Cancelled) {
+        if (waitIfPaused()) {
             emit errorOccurred(tr("Cancelled"), filename);
             return;
         }
 
         QFileInfo fileInfo(filename);
         QString newname = dest.absoluteFilePath(fileInfo.fileName());
-
-        if (filename == newname) { // pasting over the source file, so copy a renamed file
+        QString resumedName = m_resuming ? m_journal.target(filename) : QString();
+
+        if (m_resuming && (m_journal.isDone(filename) || (!fileInfo.exists() && !fileInfo.isSymLink()))) {
+            // completed before the transfer was interrupted, or already moved
+            if (m_bytesTotal >= 0 && fileInfo.isFile()) addTransferredBytes(fileInfo.size());
+            fileIndex++;
+            continue;
+        } else if (!resumedName.isEmpty()) {
+            // continued where it was interrupted
+            newname = resumedName;
+        } else if (filename == newname) { // pasting over the source file, so copy a renamed file
             if (QFileInfo::exists(newname)) {
                 newname = createNumberedFilename(newname);
             }
@@ -311,6 +662,8 @@ void FileWorker::copyOrMoveFiles()
             }
         }
 
+        m_journal.setTarget(filename, newname);
+
         // move or copy and stop if errors
         QFile file(filename);
         if (m_mode == MoveMode) {
@@ -326,14 +679,21 @@ void FileWorker::copyOrMoveFiles()
                     return;
                 }
 
-            } else if (!file.rename(newname)) {
-                emit errorOccurred(file.errorString(), filename);
-                return;
+            } else {
+                QString errmsg = moveFile(filename, newname);
+                if (!errmsg.isEmpty()) {
+                    emit errorOccurred(errmsg, filename);
+                    return;
+                }
             }
 
         } else { // CopyMode
             if (fileInfo.isDir()) {
                 QString errmsg = copyDirRecursively(filename, newname);
+
+                // wait for small files that are still being copied
+                errmsg = finishQueuedCopies(errmsg);
+
                 if (!errmsg.isEmpty()) {
                     emit errorOccurred(errmsg, filename);
                     return;
@@ -344,12 +704,24 @@ void FileWorker::copyOrMoveFiles()
                     emit errorOccurred(errmsg, filename);
                     return;
                 }
+                addTransferredFile();
             }
         }
 
+        // a cancelled item may be incomplete and must be copied again on resume
+        if (m_cancelled.loadAcquire() == Cancelled) {
+            emit errorOccurred(tr("Cancelled"), filename);
+            return;
+        }
+
+        m_journal.setDone(filename);
         fileIndex++;
     }
 
+    if (m_bytesTotal >= 0) {
+        setCurrentFile(QString(), true);
+    }
+
     m_progress = 100;
     emit progressChanged(m_progress, "");
     emit done();
@@ -379,31 +751,48 @@ QString FileWorker::copyDirRecursively(QString srcDirectory, QString destDirecto
             return tr("Cannot create target folder %1").arg(destDirectory);
     }
 
-    // copy files
-    QStringList names = srcDir.entryList(QDir::Files | QDir::Hidden);
-    for (int i = 0 ; i < names.count() ; ++i) {
+    // copy files: small files are queued so that they are copied in
+    // parallel, the folder they go to already exists at this point
+    QFileInfoList files = srcDir.entryInfoList(QDir::Files | QDir::Hidden);
+    QSharedPointer<PendingFolder> folder(new PendingFolder(srcDir.absolutePath()));
+    for (int i = 0 ; i < files.count() ; ++i) {
         // stop if cancelled
-        if (m_cancelled.loadAcquire() == Cancelled)
+        if (waitIfPaused())
             return tr("Cancelled");
 
-        QString filename = names.at(i);
-        emit progressChanged(m_progress, filename);
-        QString spath = srcDir.absoluteFilePath(filename);
-        QString dpath = destDir.absoluteFilePath(filename);
-        QString errmsg = copyOverwrite(spath, dpath);
+        // stop if a queued copy failed
+        QString errmsg = queuedCopyError();
+        if (!errmsg.isEmpty())
+            return errmsg;
+
+        const QFileInfo& info = files.at(i);
+        setCurrentFile(info.fileName(), false);
+        QString dpath = destDir.absoluteFilePath(info.fileName());
+
+        if (!info.isSymLink() && info.size() <= FILEWORKER_SMALL_FILE_SIZE) {
+            queueCopy(info.absoluteFilePath(), dpath, folder);
+            continue;
+        }
+
+        // large files are limited by bandwidth and copied here
+        errmsg = copyOverwrite(info.absoluteFilePath(), dpath);
         if (!errmsg.isEmpty())
             return errmsg;
+        addTransferredFile();
     }
 
+    // the folder is done when its last queued file is
+    releaseFolder(folder);
+
     // copy dirs
-    names = srcDir.entryList(QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Hidden);
+    QStringList names = srcDir.entryList(QDir::NoDotAndDotDot | QDir::AllDirs | QDir::Hidden);
     for (int i = 0 ; i < names.count() ; ++i) {
         // stop if cancelled
-        if (m_cancelled.loadAcquire() == Cancelled)
+        if (waitIfPaused())
             return tr("Cancelled");
 
         QString filename = names.at(i);
-        emit progressChanged(m_progress, filename);
+        setCurrentFile(filename, false);
         QString spath = srcDir.absoluteFilePath(filename);
         QString dpath = destDir.absoluteFilePath(filename);
         QString errmsg = copyDirRecursively(spath, dpath);
@@ -414,11 +803,118 @@ QString FileWorker::copyDirRecursively(QString srcDirectory, QString destDirecto
     return QString();
 }
 
+QString FileWorker::moveFile(const QString& src, const QString& dest)
+{
+    // QFile::rename() would silently copy files across file systems,
+    // and it cannot move folders there at all
+    if (::rename(QFile::encodeName(src).constData(), QFile::encodeName(dest).constData()) == 0) {
+        return QString();
+    } else if (errno != EXDEV) {
+        return QString::fromLocal8Bit(strerror(errno));
+    }
+
+    return moveAcrossDevices(src, dest);
+}
+
+QString FileWorker::moveAcrossDevices(const QString& src, const QString& dest)
+{
+    // Every file is moved on its own: it is copied to a temporary name,
+    // flushed to disk, renamed, and only then removed from the source.
+    // If moving is interrupted, each file is complete in one of both
+    // places, and only one file at a time needs space twice.
+
+    if (waitIfPaused())
+        return tr("Cancelled");
+
+    QByteArray encodedSrc = QFile::encodeName(src);
+    QByteArray encodedDest = QFile::encodeName(dest);
+
+    struct stat data;
+    if (lstat(encodedSrc.constData(), &data) != 0)
+        return QString::fromLocal8Bit(strerror(errno));
+
+    if (S_ISLNK(data.st_mode)) {
+        QByteArray target(int(data.st_size) + 1, Qt::Uninitialized);
+        ssize_t length = readlink(encodedSrc.constData(), target.data(), size_t(target.size()));
+        if (length < 0)
+            return QString::fromLocal8Bit(strerror(errno));
+        target.truncate(int(length));
+
+        if (symlink(target.constData(), encodedDest.constData()) != 0) {
+            if (errno != EEXIST)
+                return QString::fromLocal8Bit(strerror(errno));
+
+            // left over from an interrupted move, but only if it is the same link
+            QByteArray existing(target.size() + 1, Qt::Uninitialized);
+            ssize_t existingLength = readlink(encodedDest.constData(), existing.data(), size_t(existing.size()));
+            if (existingLength < 0 || existing.left(int(existingLength)) != target)
+                return QString::fromLocal8Bit(strerror(EEXIST));
+        }
+
+    } else if (S_ISDIR(data.st_mode)) {
+        // the folder may exist from an interrupted move
+        if (mkdir(encodedDest.constData(), data.st_mode & 07777) != 0 && errno != EEXIST)
+            return tr("Cannot create target folder %1").arg(dest);
+
+        QDir srcDir(src);
+        QStringList names = srcDir.entryList(QDir::NoDotAndDotDot | QDir::AllEntries |
+                                             QDir::Hidden | QDir::System);
+        for (const auto& name : names) {
+            setCurrentFile(name, false);
+            QString errmsg = moveAcrossDevices(srcDir.absoluteFilePath(name), dest + QStringLiteral("/") + name);
+            if (!errmsg.isEmpty())
+                return errmsg;
+        }
+
+        // set last, as moving the entries changed them
+        const struct timespec times[2] = {data.st_atim, data.st_mtim};
+        chmod(encodedDest.constData(), data.st_mode & 07777);
+        utimensat(AT_FDCWD, encodedDest.constData(), times, 0);
+
+        if (rmdir(encodedSrc.constData()) != 0)
+            return QString::fromLocal8Bit(strerror(errno));
+
+        return QString();
+
+    } else if (S_ISREG(data.st_mode)) {
+        QFileInfo destInfo(dest);
+        QString partial = destInfo.absolutePath() + QStringLiteral("/.") +
+                destInfo.fileName() + QStringLiteral(".part");
+        QByteArray encodedPartial = QFile::encodeName(partial);
+
+        // a file left over from an interrupted move is continued at the
+        // offset recorded in the journal, otherwise it is copied again
+        qint64 resumeOffset = m_resuming ? m_journal.offset(src) : 0;
+        if (resumeOffset == 0) unlink(encodedPartial.constData());
+
+        QString errmsg = copyResumable(src, partial, resumeOffset, true);
+        if (!errmsg.isEmpty())
+            return errmsg;
+
+        if (::rename(encodedPartial.constData(), encodedDest.constData()) != 0) {
+            errmsg = QString::fromLocal8Bit(strerror(errno));
+            unlink(encodedPartial.constData());
+            return errmsg;
+        }
+
+    } else {
+        return tr("Cannot move special file %1").arg(src);
+    }
+
+    // the file is complete at the destination now
+    if (unlink(encodedSrc.constData()) != 0)
+        return QString::fromLocal8Bit(strerror(errno));
+
+    addTransferredFile();
+    return QString();
+}
+
 QString FileWorker::copyOverwrite(QString src, QString dest)
 {
     QFileInfo fileInfo(src);
     if (fileInfo.isSymLink()) {
         // copy symlink by creating a new link
+        if (m_resuming) unlink(QFile::encodeName(dest).constData());
         QFile targetFile(fileInfo.symLinkTarget());
         if (!targetFile.link(dest))
             return targetFile.errorString();
@@ -426,10 +922,57 @@ QString FileWorker::copyOverwrite(QString src, QString dest)
         return QString();
     }
 
-    // normal file copy
-    QFile sfile(src);
-    if (!sfile.copy(dest))
-        return sfile.errorString();
+    qint64 resumeOffset = 0;
+    if (m_resuming) {
+        if (m_journal.isDone(src)) {
+            // copied before the transfer was interrupted
+            addTransferredBytes(fileInfo.size());
+            return QString();
+        }
 
-    return QString();
+        // an incomplete copy is continued, or removed if it has no offset
+        resumeOffset = m_journal.offset(src);
+        if (resumeOffset == 0) unlink(QFile::encodeName(dest).constData());
+    }
+
+    return copyResumable(src, dest, resumeOffset, false);
+}
+
+QString FileWorker::copyResumable(const QString& src, const QString& dest, qint64 resumeOffset, bool forMove)
+{
+    // normal file copy, in the kernel if possible; the offset
+    // is recorded regularly so that large files can be resumed
+    qint64 copied = 0;
+    qint64 recorded = 0;
+    FileCopier copier([this](){ return waitIfPaused(); },
+                      [&](qint64 bytes){
+        addTransferredBytes(bytes);
+        copied += bytes;
+
+        if (copied - recorded >= FILEWORKER_JOURNAL_STEP) {
+            m_journal.setOffset(src, copied);
+            recorded = copied;
+        }
+    });
+
+    copier.setKeepIncomplete(true);
+
+    // the source of a move is removed afterwards, so it must be on disk
+    copier.setSynchronous(forMove);
+    copier.setPreserveTimestamps(forMove);
+
+    QString errmsg = copier.copy(src, dest, resumeOffset);
+    if (errmsg.isEmpty()) {
+        // moved sources are gone, they only need to drop their offset
+        if (!forMove || recorded > 0 || resumeOffset > 0) m_journal.setDone(src);
+    } else if (copier.wasCancelled()) {
+        if (m_interrupted.loadAcquire() != 0) {
+            // continued when the transfer is resumed
+            m_journal.setOffset(src, copied);
+        } else {
+            unlink(QFile::encodeName(dest).constData());
+        }
+    }
+
+    return errmsg;
 }
@@ -25,6 +25,14 @@
 
 #include <QThread>
 #include <QDir>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QVariantMap>
+#include <QSharedPointer>
+#include "transferjournal.h"
 
 /**
  * @brief FileWorker does delete, copy and move files in the background.
@@ -42,12 +50,29 @@ public:
     void startCopyFiles(QStringList filenames, QString destDirectory);
     void startMoveFiles(QStringList filenames, QString destDirectory);
     void startSymlinkFiles(QStringList filenames, QString destDirectory);
+    // continues a copy or move that was interrupted, see TransferJournal
+    void startResumeTransfer();
 
     void cancel();
+    // cancels, but keeps the journal so that the transfer can be resumed
+    void interrupt();
+
+    // copying waits at the next chunk until it is resumed or cancelled
+    void pause();
+    void resume();
+    bool isPaused() const { return m_paused.loadAcquire() != 0; }
 
 signals: // signals, can be connected from a thread to another
     void progressChanged(int progress, QString filename);
 
+    // emitted before copying, see TransferPlan::toVariantMap()
+    void transferPlanned(QVariantMap plan);
+
+    // emitted regularly while copying, values are -1 if unknown
+    void transferProgressChanged(qint64 bytesDone, qint64 bytesTotal,
+                                 qint64 bytesPerSecond, qint64 secondsRemaining,
+                                 int filesDone, int filesPerSecond);
+
     // one of these is emitted when thread ends
     void done();
     void errorOccurred(QString message, QString filename);
@@ -59,7 +84,7 @@ protected:
 
 private:
     enum Mode {
-        DeleteMode, CopyMode, MoveMode, SymlinkMode
+        DeleteMode, CopyMode, MoveMode, SymlinkMode, ResumeMode
     };
     enum CancelStatus {
         Cancelled = 0, KeepRunning = 1
@@ -67,18 +92,69 @@ private:
 
     bool validateFilenames(const QStringList &filenames);
 
+    // blocks while paused, returns true if cancelled
+    bool waitIfPaused();
+    // these may be called from copy threads
+    void startTransfer(qint64 bytesTotal);
+    void setCurrentFile(const QString& filename, bool force);
+    void addTransferredBytes(qint64 bytes);
+    void addTransferredFile();
+    void reportTransfer(bool force); // requires m_transferMutex
+
+    // files of a folder that are not copied yet, see copyDirRecursively()
+    struct PendingFolder {
+        explicit PendingFolder(const QString& folderPath) : path(folderPath), pending(1) {}
+        QString path;
+        QAtomicInt pending;
+    };
+    void releaseFolder(const QSharedPointer<PendingFolder>& folder);
+
+    // copies a file in the pool, the first error is kept until finishQueuedCopies()
+    void queueCopy(const QString& src, const QString& dest, QSharedPointer<PendingFolder> folder);
+    QString queuedCopyError();
+    // waits for all queued copies, skipping the rest if there is an error
+    QString finishQueuedCopies(const QString& error);
+
     QString deleteFile(QString filename);
     void deleteFiles();
     void copyOrMoveFiles();
     void symlinkFiles();
     QString copyDirRecursively(QString srcDirectory, QString destDirectory);
     QString copyOverwrite(QString src, QString dest);
+    // copies a regular file, continuing at resumeOffset and recording offsets in the journal
+    QString copyResumable(const QString& src, const QString& dest, qint64 resumeOffset, bool forMove);
+    QString moveFile(const QString& src, const QString& dest);
+    QString moveAcrossDevices(const QString& src, const QString& dest);
 
     FileWorker::Mode m_mode;
     QStringList m_filenames;
     QString m_destDirectory;
     QAtomicInt m_cancelled; // atomic so no locks needed
     int m_progress;
+
+    QAtomicInt m_paused;
+    QAtomicInt m_interrupted;
+    QMutex m_pauseMutex;
+    QWaitCondition m_pauseCondition;
+
+    TransferJournal m_journal;
+    bool m_resuming = {false};
+
+    QThreadPool m_copyPool;
+    QSemaphore m_queuedCopies;
+
+    // guarded by m_transferMutex
+    QMutex m_transferMutex;
+    QString m_currentFile;
+    QString m_queuedCopyError;
+    qint64 m_bytesDone = {0};
+    qint64 m_bytesTotal = {-1};
+    qint64 m_bytesAtLastReport = {0};
+    double m_bytesPerSecond = {0};
+    int m_filesDone = {0};
+    int m_filesAtLastReport = {0};
+    double m_filesPerSecond = {0};
+    QElapsedTimer m_reportTimer;
 };
 
 #endif // FILEWORKER_H
@@ -21,7 +21,6 @@
  */
 
 #include "globals.h"
-#include <cmath>
 #include <QCoreApplication>
 #include <QLocale>
 #include <QProcess>
@@ -92,23 +91,22 @@ QString filesizeToString(qint64 filesize)
     // convert to KiB, MiB, GiB: we follow SI and use 1024 as divisor.
     // Values are called properly *bibyte instead of **byte, i.e. kibibyte.
     QLocale locale;
-    QStringListIterator i(fileSizeNames);
-    QString unit(i.next()); // = first
+    int unit = 0;
+    qint64 divisor = 1;
 
-    uint power = 0;
-    while (filesize >= pow(1024, power+1) && i.hasNext()) {
-        unit = i.next();
-        power++;
+    while (filesize / divisor >= 1024 && unit + 1 < fileSizeNames.count()) {
+        divisor *= 1024;
+        unit++;
     }
 
     if (filesize < 1024LL) {
         //: 1=file size (number), 2=unit (e.g. KiB)
         return QCoreApplication::translate("FileSize", "%1 %2").
-                arg(locale.toString(filesize)).arg(unit);
+                arg(locale.toString(filesize)).arg(fileSizeNames.at(unit));
     } else {
-        auto num = static_cast<double>(filesize)/pow(1024, power);
+        auto num = static_cast<double>(filesize)/divisor;
         return QCoreApplication::translate("FileSize", "%1 %2").
-                arg(locale.toString(num, 'f', 2)).arg(unit);
+                arg(locale.toString(num, 'f', 2)).arg(fileSizeNames.at(unit));
     }
 }
 
@@ -139,6 +137,18 @@ QString infoToIconName(const StatFileInfo &info)
     return "file";
 }
 
+QString infoToIconName(const EntryTable &entries, int row)
+{
+    if (entries.isSymLink(row) && entries.isDirAtEnd(row)) return "folder-link";
+    if (entries.isDir(row)) return "folder";
+    if (entries.isSymLink(row)) return "link";
+    if (entries.isFileAtEnd(row)) {
+        QString suffix = entries.suffix(row).toLower();
+        return suffixToIconName(suffix);
+    }
+    return "file";
+}
+
 QString execute(QString command, QStringList arguments, bool mergeErrorStream)
 {
     QProcess process;
@@ -27,6 +27,7 @@
 #include <QDateTime>
 #include <QDir>
 #include "statfileinfo.h"
+#include "entrytable.h"
 
 // Global functions
 
@@ -36,6 +37,7 @@ QString filesizeToString(qint64 filesize);
 QString datetimeToString(QDateTime datetime, bool longFormat = false);
 
 QString infoToIconName(const StatFileInfo &info);
+QString infoToIconName(const EntryTable &entries, int row);
 
 // Always make sure to use the correct APIs!
 // Since SailfishOS 3.3.x.x, GNU coreutils has been replaced by BusyBox.
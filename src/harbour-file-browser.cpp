@@ -48,8 +48,8 @@ int main(int argc, char *argv[])
     // /home/USER/.config/harbour-file-browser/harbour-file-browser.conf
 
     qRegisterMetaType<FileModelWorker::Mode>("FileModelWorker::Mode");
-    qRegisterMetaType<StatFileInfo>("StatFileInfo");
-    qRegisterMetaType<QList<StatFileInfo>>("QList<StatFileInfo>");
+    qRegisterMetaType<EntryTable>("EntryTable");
+    qRegisterMetaType<EntryDiff>("EntryDiff");
     qmlRegisterType<FileModel>("harbour.file.browser.FileModel", 1, 0, "FileModel");
     qmlRegisterType<FileData>("harbour.file.browser.FileData", 1, 0, "FileData");
     qmlRegisterType<SearchEngine>("harbour.file.browser.SearchEngine", 1, 0, "SearchEngine");
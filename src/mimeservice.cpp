@@ -0,0 +1,146 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <QFile>
+#include <QHash>
+#include <QMutexLocker>
+#include <QPair>
+#include <QMimeDatabase>
+#include <QRunnable>
+#include <QDebug>
+#include "mimeservice.h"
+
+// Number of files whose types are kept.
+#ifndef MIMESERVICE_CACHE_SIZE
+#define MIMESERVICE_CACHE_SIZE 8192
+#endif
+
+uint qHash(const MimeService::Key& key, uint seed)
+{
+    // qHash() of a pair passes the seed to both parts and combines them
+    return qHash(qMakePair(qMakePair(quint64(key.device), quint64(key.inode)), qint64(key.modTime)), seed);
+}
+
+namespace {
+class ClassifyJob : public QRunnable
+{
+public:
+    ClassifyJob(EntryTable entries, QAtomicInt* generation) :
+        m_entries(entries), m_generation(generation), m_startGeneration(generation->loadAcquire()) {
+        setAutoDelete(true);
+    }
+
+    void run() override {
+        QMimeDatabase db;
+        int classified = 0;
+
+        for (int row = 0; row < m_entries.count(); ++row) {
+            // a newer listing was requested
+            if (m_generation->loadAcquire() != m_startGeneration) return;
+            if (!m_entries.isFileAtEnd(row)) continue;
+            if (db.mimeTypesForFileName(m_entries.name(row)).count() == 1) continue;
+
+            MimeService::instance()->mimeTypeForFile(m_entries.absoluteFilePath(row));
+            ++classified;
+        }
+
+        qDebug() << "[MimeService] classified" << classified << "files by content in" << m_entries.directoryPrefix();
+    }
+
+private:
+    EntryTable m_entries;
+    QAtomicInt* m_generation;
+    int m_startGeneration;
+};
+}
+
+MimeService* MimeService::instance()
+{
+    static MimeService service;
+    return &service;
+}
+
+MimeService::MimeService()
+{
+    m_cache.setMaxCost(MIMESERVICE_CACHE_SIZE);
+    m_pool.setMaxThreadCount(1);
+}
+
+MimeService::~MimeService()
+{
+    cancelBackground();
+    m_pool.waitForDone();
+}
+
+QMimeType MimeService::mimeTypeForFile(const QString& path)
+{
+    struct stat statData;
+    if (stat(QFile::encodeName(path).constData(), &statData) != 0) {
+        // e.g. broken links, they can only be classified by name
+        return QMimeDatabase().mimeTypeForFile(path, QMimeDatabase::MatchExtension);
+    }
+
+    return mimeTypeForFile(path, statData);
+}
+
+QMimeType MimeService::mimeTypeForFile(const QString& path, const struct stat& statData)
+{
+    QMimeDatabase db;
+    Key key = {statData.st_dev, statData.st_ino,
+               qint64(statData.st_mtim.tv_sec) * 1000000000LL + statData.st_mtim.tv_nsec};
+
+    {
+        QMutexLocker locker(&m_mutex);
+        if (QString* name = m_cache.object(key)) {
+            return db.mimeTypeForName(*name);
+        }
+    }
+
+    QMimeType type;
+    if (S_ISDIR(statData.st_mode)) {
+        type = db.mimeTypeForName(QStringLiteral("inode/directory"));
+    } else {
+        // the name is enough if it matches exactly one type
+        QList<QMimeType> byName = db.mimeTypesForFileName(path);
+        if (byName.count() == 1) {
+            type = byName.first();
+        } else {
+            type = db.mimeTypeForFile(path, QMimeDatabase::MatchDefault);
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_cache.insert(key, new QString(type.name()));
+    return type;
+}
+
+void MimeService::classifyInBackground(const EntryTable& entries)
+{
+    // cancels the previous batch
+    m_batchGeneration.ref();
+    m_pool.start(new ClassifyJob(entries, &m_batchGeneration));
+}
+
+void MimeService::cancelBackground()
+{
+    m_batchGeneration.ref();
+    m_pool.clear();
+}
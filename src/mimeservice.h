@@ -0,0 +1,82 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MIMESERVICE_H
+#define MIMESERVICE_H
+
+#include <sys/stat.h>
+#include <QString>
+#include <QMimeType>
+#include <QCache>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QThreadPool>
+#include "entrytable.h"
+
+/**
+ * @brief The MimeService class finds the mime types of files.
+ *
+ * Files are classified by their name first. The file content is only
+ * read if the name does not match exactly one type. Results are cached
+ * by device, inode, and modification time of the file, so they are
+ * valid until the file is changed.
+ *
+ * Files of a listing whose type can't be told by their name can be
+ * classified in the background, so that looking them up later does
+ * not have to read them on the main thread. All methods are thread-safe.
+ */
+class MimeService
+{
+public:
+    static MimeService* instance();
+
+    // symlinks are followed
+    QMimeType mimeTypeForFile(const QString& path);
+    QString mimeTypeNameForFile(const QString& path) { return mimeTypeForFile(path).name(); }
+
+    // Classifies all entries that can't be classified by name.
+    // Only the last requested listing is classified.
+    void classifyInBackground(const EntryTable& entries);
+    void cancelBackground();
+
+private:
+    explicit MimeService();
+    ~MimeService();
+
+    QMimeType mimeTypeForFile(const QString& path, const struct stat& statData);
+
+    struct Key {
+        dev_t device;
+        ino_t inode;
+        qint64 modTime; // nanoseconds since epoch
+        bool operator==(const Key& other) const {
+            return device == other.device && inode == other.inode && modTime == other.modTime;
+        }
+    };
+    friend uint qHash(const Key& key, uint seed);
+
+    QMutex m_mutex;
+    QCache<Key, QString> m_cache; // mime type names
+    QThreadPool m_pool;
+    QAtomicInt m_batchGeneration = {0};
+};
+
+#endif // MIMESERVICE_H
@@ -0,0 +1,99 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "refreshscheduler.h"
+
+// Delay for merging changes to a directory that was quiet before.
+#ifndef REFRESHSCHEDULER_MIN_DELAY_MSEC
+#define REFRESHSCHEDULER_MIN_DELAY_MSEC 100
+#endif
+
+// Upper limit of the delay for directories that keep changing.
+#ifndef REFRESHSCHEDULER_MAX_DELAY_MSEC
+#define REFRESHSCHEDULER_MAX_DELAY_MSEC 3000
+#endif
+
+RefreshScheduler::RefreshScheduler(QObject *parent) :
+    QObject(parent), m_delay(REFRESHSCHEDULER_MIN_DELAY_MSEC)
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &RefreshScheduler::deliver);
+}
+
+void RefreshScheduler::addEntries(const QStringList& names)
+{
+    for (const auto& name : names) m_names.insert(name);
+    schedule();
+}
+
+void RefreshScheduler::addFullRefresh()
+{
+    m_fullRefresh = true;
+    m_names.clear(); // included in the full refresh
+    schedule();
+}
+
+void RefreshScheduler::setHeld(bool held)
+{
+    m_held = held;
+    if (!m_held && hasPending()) schedule();
+}
+
+void RefreshScheduler::clear()
+{
+    m_timer.stop();
+    m_names.clear();
+    m_fullRefresh = false;
+    m_delay = REFRESHSCHEDULER_MIN_DELAY_MSEC;
+    m_sinceDelivery.invalidate();
+}
+
+void RefreshScheduler::schedule()
+{
+    // Changes arriving while the timer runs are merged into the
+    // pending refresh, so the timer is never restarted. This way,
+    // a steady stream of changes still causes regular refreshes.
+    if (m_timer.isActive()) return;
+
+    if (m_sinceDelivery.isValid() && m_sinceDelivery.elapsed() < 2 * m_delay) {
+        // still changing since the last refresh: back off
+        m_delay = qMin(2 * m_delay, REFRESHSCHEDULER_MAX_DELAY_MSEC);
+    } else {
+        m_delay = REFRESHSCHEDULER_MIN_DELAY_MSEC;
+    }
+
+    m_timer.start(m_delay);
+}
+
+void RefreshScheduler::deliver()
+{
+    // setHeld(false) reschedules pending changes
+    if (m_held || !hasPending()) return;
+
+    if (m_fullRefresh) {
+        emit fullRefreshRequested();
+    } else {
+        emit entriesRefreshRequested(m_names.toList());
+    }
+
+    m_names.clear();
+    m_fullRefresh = false;
+    m_sinceDelivery.restart();
+}
@@ -0,0 +1,74 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef REFRESHSCHEDULER_H
+#define REFRESHSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QStringList>
+
+/**
+ * @brief The RefreshScheduler class merges bursts of change notifications.
+ *
+ * Changes are collected for a short delay before a refresh is requested.
+ * If the directory keeps changing, the delay is doubled for every refresh
+ * up to a maximum, and it is reset once the directory has been quiet for
+ * a while. Changes that arrive while a refresh is running are held back
+ * and delivered when it is done, so the last change is never lost.
+ */
+class RefreshScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RefreshScheduler(QObject *parent = nullptr);
+
+    void addEntries(const QStringList& names);
+    void addFullRefresh();
+
+    // while held, refreshes are delayed until released
+    void setHeld(bool held);
+    void clear();
+
+    int currentDelay() const { return m_delay; }
+
+signals:
+    void entriesRefreshRequested(QStringList names);
+    void fullRefreshRequested();
+
+private slots:
+    void deliver();
+
+private:
+    void schedule();
+    bool hasPending() const { return m_fullRefresh || !m_names.isEmpty(); }
+
+    QTimer m_timer;
+    QElapsedTimer m_sinceDelivery;
+    QSet<QString> m_names;
+    bool m_fullRefresh = {false};
+    bool m_held = {false};
+    int m_delay;
+};
+
+#endif // REFRESHSCHEDULER_H
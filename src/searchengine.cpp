@@ -20,11 +20,11 @@
  */
 
 #include "searchengine.h"
-#include <QMimeDatabase>
 #include <QDateTime>
 #include "searchworker.h"
 #include "statfileinfo.h"
 #include "globals.h"
+#include "mimeservice.h"
 
 SearchEngine::SearchEngine(QObject *parent) :
     QObject(parent)
@@ -85,8 +85,7 @@ void SearchEngine::cancel()
 void SearchEngine::emitMatchFound(QString fullpath)
 {
     StatFileInfo info(fullpath);
-    QMimeDatabase db;
-    QString mimeType = db.mimeTypeForFile(fullpath).name();
+    QString mimeType = MimeService::instance()->mimeTypeNameForFile(fullpath);
     emit matchFound(fullpath, info.fileName(), info.absoluteDir().absolutePath(),
                     infoToIconName(info), info.kind(), mimeType);
 }
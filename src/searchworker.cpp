@@ -22,6 +22,7 @@
 
 #include "searchworker.h"
 #include <QDateTime>
+#include <QFileInfo>
 #include <QSettings>
 #include "globals.h"
 
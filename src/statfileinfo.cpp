@@ -19,30 +19,72 @@
  * this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
+#include <unistd.h>
 #include "statfileinfo.h"
+#include "usernamecache.h"
+
+namespace {
+QString cleanAbsolutePath(const QString& path)
+{
+    // same as QFileInfo::absoluteFilePath()
+    if (path.isEmpty()) return QString();
+    return QDir::cleanPath(QDir::isAbsolutePath(path) ? path : QDir::current().absoluteFilePath(path));
+}
+}
 
 StatFileInfo::StatFileInfo() :
-    m_filename(""), m_selected(false)
+    m_absoluteFilePath(""), m_selected(false)
 {
     refresh();
 }
 
 StatFileInfo::StatFileInfo(const QString& filename) :
-    m_filename(filename), m_selected(false)
+    m_absoluteFilePath(cleanAbsolutePath(filename)), m_selected(false)
 {
     refresh();
 }
 
+StatFileInfo::StatFileInfo(const QString &filename, const struct stat &lstatData,
+                           const struct stat &statData) :
+    m_absoluteFilePath(cleanAbsolutePath(filename)), m_selected(false)
+{
+    memcpy(&m_lstat, &lstatData, sizeof(m_lstat));
+    memcpy(&m_stat, &statData, sizeof(m_stat));
+}
+
 StatFileInfo::~StatFileInfo()
 {
 }
 
 void StatFileInfo::setFile(QString filename)
 {
-    m_filename = filename;
+    m_absoluteFilePath = cleanAbsolutePath(filename);
     refresh();
 }
 
+QString StatFileInfo::fileName() const
+{
+    return m_absoluteFilePath.mid(m_absoluteFilePath.lastIndexOf('/') + 1);
+}
+
+QString StatFileInfo::absolutePath() const
+{
+    int lastSlash = m_absoluteFilePath.lastIndexOf('/');
+    if (lastSlash < 0) return QString();
+    if (lastSlash == 0) return QStringLiteral("/");
+    return m_absoluteFilePath.left(lastSlash);
+}
+
+QString StatFileInfo::suffix() const
+{
+    // same as QFileInfo::suffix()
+    QString name = fileName();
+    int lastDot = name.lastIndexOf('.');
+    if (lastDot < 0) return QString();
+    return name.mid(lastDot+1);
+}
+
 QString StatFileInfo::kind() const
 {
     if (isSymLink()) return "l";
@@ -55,20 +97,72 @@ QString StatFileInfo::kind() const
     return "?";
 }
 
+QFile::Permissions StatFileInfo::permissions() const
+{
+    // permissions of the target, as reported by QFileInfo
+    mode_t mode = m_stat.st_mode;
+    QFile::Permissions perms;
+    if (mode & S_IRUSR) perms |= QFile::ReadOwner;
+    if (mode & S_IWUSR) perms |= QFile::WriteOwner;
+    if (mode & S_IXUSR) perms |= QFile::ExeOwner;
+    if (mode & S_IRGRP) perms |= QFile::ReadGroup;
+    if (mode & S_IWGRP) perms |= QFile::WriteGroup;
+    if (mode & S_IXGRP) perms |= QFile::ExeGroup;
+    if (mode & S_IROTH) perms |= QFile::ReadOther;
+    if (mode & S_IWOTH) perms |= QFile::WriteOther;
+    if (mode & S_IXOTH) perms |= QFile::ExeOther;
+
+    // Permissions of the current user are asked from the system like
+    // QFileInfo does, the mode bits do not cover root, supplementary
+    // groups, ACLs, or read-only mounts.
+    if (m_userPermissions < 0) {
+        QFile::Permissions user;
+        if (exists()) {
+            QByteArray path = QFile::encodeName(m_absoluteFilePath);
+            if (access(path.constData(), R_OK) == 0) user |= QFile::ReadUser;
+            if (access(path.constData(), W_OK) == 0) user |= QFile::WriteUser;
+            if (access(path.constData(), X_OK) == 0) user |= QFile::ExeUser;
+        }
+        m_userPermissions = int(user);
+    }
+
+    perms |= QFile::Permissions(QFlag(m_userPermissions));
+
+    return perms;
+}
+
+QString StatFileInfo::owner() const
+{
+    if (!exists()) return QString();
+    return UserNameCache::instance()->userName(m_stat.st_uid);
+}
+
+QString StatFileInfo::group() const
+{
+    if (!exists()) return QString();
+    return UserNameCache::instance()->groupName(m_stat.st_gid);
+}
+
+QDateTime StatFileInfo::lastModified() const
+{
+    return QDateTime::fromMSecsSinceEpoch(lastModifiedNsec() / 1000000LL);
+}
+
+QDateTime StatFileInfo::created() const
+{
+    return QDateTime::fromMSecsSinceEpoch(qint64(m_stat.st_ctim.tv_sec) * 1000LL +
+                                          m_stat.st_ctim.tv_nsec / 1000000LL);
+}
+
 uint StatFileInfo::dirSize() const
 {
     if (!isDirAtEnd()) return 0;
-    return QDir(m_fileInfo.absoluteFilePath(),
+    return QDir(m_absoluteFilePath,
                 QStringLiteral(""),
                 QDir::NoSort, QDir::AllEntries |
                 QDir::NoDotAndDotDot | QDir::Hidden).count();
 }
 
-bool StatFileInfo::exists() const
-{
-    return m_fileInfo.exists();
-}
-
 bool StatFileInfo::isSafeToRead() const
 {
     // it is safe to read non-existing files
@@ -79,12 +173,22 @@ bool StatFileInfo::isSafeToRead() const
     return isFileAtEnd();
 }
 
-bool StatFileInfo::isSymLinkBroken() const
+QString StatFileInfo::symLinkTarget() const
 {
-    // if it is a symlink but it doesn't exist, then it is broken
-    if (m_fileInfo.isSymLink() && !m_fileInfo.exists())
-        return true;
-    return false;
+    if (!isSymLink()) return QString();
+
+    QByteArray target(int(qMax(qint64(m_lstat.st_size), qint64(255))) + 1, '\0');
+    ssize_t length = readlink(QFile::encodeName(m_absoluteFilePath).constData(),
+                              target.data(), size_t(target.size()));
+    if (length < 0) return QString();
+    target.truncate(int(length));
+
+    // relative targets are resolved like QFileInfo does
+    QString targetPath = QFile::decodeName(target);
+    if (QDir::isRelativePath(targetPath)) {
+        targetPath = absolutePath() + '/' + targetPath;
+    }
+    return QDir::cleanPath(targetPath);
 }
 
 void StatFileInfo::setSelected(bool selected)
@@ -96,13 +200,13 @@ void StatFileInfo::refresh()
 {
     memset(&m_stat, 0, sizeof(m_stat));
     memset(&m_lstat, 0, sizeof(m_lstat));
+    m_userPermissions = -1;
 
-    m_fileInfo = QFileInfo(m_filename);
-    if (m_filename.isEmpty())
+    if (m_absoluteFilePath.isEmpty())
         return;
 
-    QByteArray ba = m_filename.toUtf8();
-    char *fn = ba.data();
+    QByteArray encoded = QFile::encodeName(m_absoluteFilePath);
+    const char *fn = encoded.constData();
 
     // check the file without following symlinks
     int res = lstat(fn, &m_lstat);
@@ -120,6 +224,4 @@ void StatFileInfo::refresh()
     if (res != 0) { // if error, then set to undefined
         m_stat.st_mode = 0;
     }
-
 }
-
@@ -22,30 +22,37 @@
 #ifndef STATFILEINFO_H
 #define STATFILEINFO_H
 
-#include <QFileInfo>
+#include <QFile>
 #include <QDateTime>
 #include <QDir>
 #include <sys/stat.h>
 
 /**
  * @brief The StatFileInfo class is like QFileInfo, but has more detailed information about file types.
+ *
+ * All metadata is taken from the stat data read once when the file is set.
+ * Only the symlink target needs an extra call, which is made when it is
+ * requested. Owner and group names are cached for all files.
  */
 class StatFileInfo
 {
 public:
     explicit StatFileInfo();
     explicit StatFileInfo(const QString &filename);
+    // use already known stat data instead of reading it again
+    explicit StatFileInfo(const QString &filename, const struct stat &lstatData,
+                          const struct stat &statData);
     ~StatFileInfo();
 
     void setFile(QString filename);
-    QString fileName() const { return m_fileInfo.fileName(); }
+    QString fileName() const;
 
     // these inspect the file itself without following symlinks
 
-    // directory
-    bool isDir() const { return m_fileInfo.isDir(); /*S_ISDIR(m_lstat.st_mode);*/ }
+    // directory (this follows symlinks, like QFileInfo::isDir did)
+    bool isDir() const { return S_ISDIR(m_stat.st_mode); }
     // symbolic link
-    bool isSymLink() const { return m_fileInfo.isSymLink(); /*return S_ISLNK(m_lstat.st_mode);*/ }
+    bool isSymLink() const { return S_ISLNK(m_lstat.st_mode); }
     // block special file
     bool isBlk() const { return S_ISBLK(m_lstat.st_mode); }
     // character special file
@@ -63,7 +70,7 @@ public:
     // these inspect the file or if it is a symlink, then its target end point
 
     // directory
-    bool isDirAtEnd() const { return m_fileInfo.isDir(); /*S_ISDIR(m_stat.st_mode);*/ }
+    bool isDirAtEnd() const { return S_ISDIR(m_stat.st_mode); }
     // block special file
     bool isBlkAtEnd() const { return S_ISBLK(m_stat.st_mode); }
     // character special file
@@ -80,27 +87,29 @@ public:
     // these inspect the file or if it is a symlink, then its target end point
 
     QString kind() const;
-    QFile::Permissions permissions() const { return m_fileInfo.permissions(); }
-    QString group() const { return m_fileInfo.group(); }
-    uint groupId() const { return m_fileInfo.groupId(); }
-    QString owner() const { return m_fileInfo.owner(); }
-    uint ownerId() const { return m_fileInfo.ownerId(); }
-    qint64 size() const { return m_fileInfo.size(); }
+    QFile::Permissions permissions() const;
+    QString group() const; // see UserNameCache
+    uint groupId() const { return m_stat.st_gid; }
+    QString owner() const; // see UserNameCache
+    uint ownerId() const { return m_stat.st_uid; }
+    qint64 size() const { return m_stat.st_size; }
     uint dirSize() const;
     qint64 lastModifiedStat() const { return m_stat.st_mtime; }
-    QDateTime lastModified() const { return m_fileInfo.lastModified(); }
-    QDateTime created() const { return m_fileInfo.created(); }
-    bool exists() const;
+    qint64 lastModifiedNsec() const { return qint64(m_stat.st_mtim.tv_sec) * 1000000000LL + m_stat.st_mtim.tv_nsec; }
+    QDateTime lastModified() const;
+    // time of the last status change, which is what QFileInfo reports on Linux
+    QDateTime created() const;
+    bool exists() const { return m_stat.st_mode != 0; }
     bool isSafeToRead() const;
 
     // path accessors
 
-    QDir absoluteDir() const { return m_fileInfo.absoluteDir(); }
-    QString absolutePath() const { return m_fileInfo.absolutePath(); }
-    QString absoluteFilePath() const { return m_fileInfo.absoluteFilePath(); }
-    QString suffix() const { return m_fileInfo.suffix(); }
-    QString symLinkTarget() const { return m_fileInfo.symLinkTarget(); }
-    bool isSymLinkBroken() const;
+    QDir absoluteDir() const { return QDir(absolutePath()); }
+    QString absolutePath() const;
+    QString absoluteFilePath() const { return m_absoluteFilePath; }
+    QString suffix() const;
+    QString symLinkTarget() const; // read on demand
+    bool isSymLinkBroken() const { return isSymLink() && !exists(); }
 
     // Doomed paths will become invalid soon because the file
     // is being moved or deleted. This is not real file metadata
@@ -115,12 +124,12 @@ public:
     void refresh();
 
 private:
-    QString m_filename;
-    QFileInfo m_fileInfo;
+    QString m_absoluteFilePath;
     struct stat m_stat; // after following possible symlinks
     struct stat m_lstat; // file itself without following symlinks
     bool m_selected;
     bool m_doomed = {false};
+    mutable int m_userPermissions = {-1}; // checked when first needed
 };
 
 inline bool operator==(const StatFileInfo& f1, const StatFileInfo& f2)
@@ -135,21 +144,17 @@ inline bool operator==(const StatFileInfo& f1, const StatFileInfo& f2)
 
 inline uint qHash(const StatFileInfo& key, uint seed=10)
 {
-    QByteArray result;
-    result.reserve(45);
-    result.append(QByteArray::number(qHash(key.fileName(), seed)));
-    result.append('#');
-    result.append(QByteArray::number(key.size()));
-    result.append('#');
-    result.append(QByteArray::number(qHash(key.permissions(), seed)));
-    result.append('#');
-    result.append(QByteArray::number(key.lastModifiedStat()));
-    result.append('#');
-    result.append(key.isSymLink());
-    result.append('#');
-    result.append(key.isDirAtEnd());
-    // qDebug() << "hashed" << f.fileName() << "to" << result << "(" << result.size() << ")";
-    return qHash(result, seed);
+    // combines the fields compared in operator== without
+    // building an intermediate string
+    uint hash = qHash(key.fileName(), seed);
+    auto combine = [&hash](uint value){
+        hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    };
+    combine(qHash(key.size(), seed));
+    combine(qHash(uint(key.permissions()), seed));
+    combine(qHash(key.lastModifiedStat(), seed));
+    combine(uint(key.isSymLink()) | (uint(key.isDirAtEnd()) << 1));
+    return hash;
 }
 
 #endif // STATFILEINFO_H
@@ -0,0 +1,322 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QDebug>
+#include "transferjournal.h"
+
+// Maximum delay before records of completed files are written.
+#ifndef TRANSFERJOURNAL_WRITE_INTERVAL_MSEC
+#define TRANSFERJOURNAL_WRITE_INTERVAL_MSEC 250
+#endif
+
+// The journal is rewritten when it grows beyond this size,
+// and beyond twice its size after the last rewrite.
+#ifndef TRANSFERJOURNAL_COMPACT_SIZE
+#define TRANSFERJOURNAL_COMPACT_SIZE (256*1024)
+#endif
+
+// Records are lines of tab separated fields. Paths are percent-encoded,
+// so that they cannot contain tabs or line breaks.
+namespace {
+const QByteArray journalHeader = QByteArrayLiteral("harbour-file-browser transfer journal 1");
+
+QByteArray encodePath(const QString& path)
+{
+    return path.toUtf8().toPercentEncoding("/ ");
+}
+
+QString decodePath(const QByteArray& field)
+{
+    return QString::fromUtf8(QByteArray::fromPercentEncoding(field));
+}
+
+QString folderOf(const QString& path)
+{
+    return path.left(path.lastIndexOf('/'));
+}
+
+QString nameOf(const QString& path)
+{
+    return path.mid(path.lastIndexOf('/') + 1);
+}
+}
+
+QString TransferJournal::journalPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+            QStringLiteral("/transfer.journal");
+}
+
+bool TransferJournal::exists()
+{
+    return QFile::exists(journalPath());
+}
+
+void TransferJournal::remove()
+{
+    QFile::remove(journalPath());
+}
+
+void TransferJournal::clearState()
+{
+    m_file.close();
+    m_buffer.clear();
+    m_compactedSize = 0;
+    m_mode = NoMode;
+    m_sources.clear();
+    m_destDirectory.clear();
+    m_targets.clear();
+    m_offsets.clear();
+    m_done.clear();
+    m_doneFolders.clear();
+}
+
+bool TransferJournal::begin(Mode mode, const QStringList& sources, const QString& destDirectory)
+{
+    QMutexLocker locker(&m_mutex);
+    clearState();
+    m_mode = mode;
+    m_sources = sources;
+    m_destDirectory = destDirectory;
+
+    QDir().mkpath(QFileInfo(journalPath()).absolutePath());
+    m_file.setFileName(journalPath());
+    if (!m_file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qDebug() << "[TransferJournal] cannot write journal:" << m_file.errorString();
+        return false;
+    }
+
+    m_sinceWrite.start();
+    append(journalHeader, false);
+    append("mode\t" + QByteArray(mode == MoveMode ? "move" : "copy"), false);
+    append("dest\t" + encodePath(destDirectory), false);
+    for (const auto& source : sources) append("source\t" + encodePath(source), false);
+    writeBuffer();
+    return true;
+}
+
+bool TransferJournal::load()
+{
+    QMutexLocker locker(&m_mutex);
+    clearState();
+
+    m_file.setFileName(journalPath());
+    if (!m_file.open(QFile::ReadOnly)) return false;
+
+    if (m_file.readLine().trimmed() != journalHeader) {
+        qDebug() << "[TransferJournal] ignoring journal of unknown format";
+        m_file.close();
+        return false;
+    }
+
+    while (!m_file.atEnd()) {
+        QByteArray line = m_file.readLine();
+
+        // the last record may be incomplete if the app was killed
+        if (!line.endsWith('\n')) break;
+
+        QList<QByteArray> fields = line.trimmed().split('\t');
+        const QByteArray& type = fields.first();
+
+        if (type == "mode" && fields.count() == 2) {
+            m_mode = fields.at(1) == "move" ? MoveMode : CopyMode;
+        } else if (type == "dest" && fields.count() == 2) {
+            m_destDirectory = decodePath(fields.at(1));
+        } else if (type == "source" && fields.count() == 2) {
+            m_sources.append(decodePath(fields.at(1)));
+        } else if (type == "target" && fields.count() == 3) {
+            m_targets.insert(decodePath(fields.at(1)), decodePath(fields.at(2)));
+        } else if (type == "done" && fields.count() == 2) {
+            markDone(decodePath(fields.at(1)));
+        } else if (type == "folder" && fields.count() == 2) {
+            markFolderDone(decodePath(fields.at(1)));
+        } else if (type == "offset" && fields.count() == 3) {
+            m_offsets.insert(decodePath(fields.at(1)), fields.at(2).toLongLong());
+        }
+    }
+
+    m_file.close();
+    if (m_mode == NoMode || m_sources.isEmpty() || m_destDirectory.isEmpty()) {
+        return false;
+    }
+
+    // new records are added to the existing journal
+    if (!m_file.open(QFile::WriteOnly | QFile::Append)) return false;
+    m_compactedSize = m_file.size();
+    m_sinceWrite.start();
+    return true;
+}
+
+void TransferJournal::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    writeBuffer();
+}
+
+void TransferJournal::finish()
+{
+    QMutexLocker locker(&m_mutex);
+    clearState();
+    remove();
+}
+
+QString TransferJournal::target(const QString& source) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_targets.value(source);
+}
+
+bool TransferJournal::isDone(const QString& source) const
+{
+    QMutexLocker locker(&m_mutex);
+    QString folder = folderOf(source);
+    if (m_doneFolders.contains(folder)) return true;
+
+    auto it = m_done.constFind(folder);
+    return it != m_done.constEnd() && it->contains(nameOf(source));
+}
+
+qint64 TransferJournal::offset(const QString& source) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_offsets.value(source, 0);
+}
+
+void TransferJournal::setTarget(const QString& source, const QString& target)
+{
+    QMutexLocker locker(&m_mutex);
+    m_targets.insert(source, target);
+    append("target\t" + encodePath(source) + '\t' + encodePath(target), true);
+}
+
+void TransferJournal::setDone(const QString& source)
+{
+    QMutexLocker locker(&m_mutex);
+    markDone(source);
+    append("done\t" + encodePath(source), false);
+}
+
+void TransferJournal::setFolderDone(const QString& folder)
+{
+    QMutexLocker locker(&m_mutex);
+    markFolderDone(folder);
+    append("folder\t" + encodePath(folder), false);
+}
+
+void TransferJournal::setOffset(const QString& source, qint64 offset)
+{
+    QMutexLocker locker(&m_mutex);
+    m_offsets.insert(source, offset);
+    append("offset\t" + encodePath(source) + '\t' + QByteArray::number(offset), true);
+}
+
+void TransferJournal::markDone(const QString& source)
+{
+    m_offsets.remove(source);
+    QString folder = folderOf(source);
+    if (!m_doneFolders.contains(folder)) m_done[folder].insert(nameOf(source));
+}
+
+void TransferJournal::markFolderDone(const QString& folder)
+{
+    // the records of its files are not needed anymore
+    m_done.remove(folder);
+    m_doneFolders.insert(folder);
+}
+
+void TransferJournal::append(const QByteArray& record, bool now)
+{
+    if (!m_file.isOpen()) return;
+    m_buffer.append(record);
+    m_buffer.append('\n');
+
+    if (now || m_sinceWrite.elapsed() >= TRANSFERJOURNAL_WRITE_INTERVAL_MSEC) {
+        writeBuffer();
+    }
+}
+
+void TransferJournal::writeBuffer()
+{
+    m_sinceWrite.restart();
+    if (!m_file.isOpen() || m_buffer.isEmpty()) return;
+
+    // flushed right away, the kernel keeps the data if the app is killed
+    m_file.write(m_buffer);
+    m_file.flush();
+    m_buffer.clear();
+
+    if (m_file.size() > TRANSFERJOURNAL_COMPACT_SIZE && m_file.size() > 2 * m_compactedSize) {
+        rewrite();
+    }
+}
+
+void TransferJournal::rewrite()
+{
+    QString newPath = journalPath() + QStringLiteral(".new");
+    QFile newFile(newPath);
+    if (!newFile.open(QFile::WriteOnly | QFile::Truncate)) return;
+
+    QByteArray data;
+    data.append(journalHeader + '\n');
+    data.append("mode\t" + QByteArray(m_mode == MoveMode ? "move" : "copy") + '\n');
+    data.append("dest\t" + encodePath(m_destDirectory) + '\n');
+    for (const auto& source : m_sources) data.append("source\t" + encodePath(source) + '\n');
+
+    for (auto it = m_targets.constBegin(); it != m_targets.constEnd(); ++it) {
+        data.append("target\t" + encodePath(it.key()) + '\t' + encodePath(it.value()) + '\n');
+    }
+
+    for (const auto& folder : m_doneFolders) data.append("folder\t" + encodePath(folder) + '\n');
+
+    for (auto it = m_done.constBegin(); it != m_done.constEnd(); ++it) {
+        for (const auto& name : it.value()) {
+            data.append("done\t" + encodePath(it.key() + '/' + name) + '\n');
+        }
+    }
+
+    for (auto it = m_offsets.constBegin(); it != m_offsets.constEnd(); ++it) {
+        data.append("offset\t" + encodePath(it.key()) + '\t' + QByteArray::number(it.value()) + '\n');
+    }
+
+    bool ok = newFile.write(data) == data.size() && newFile.flush();
+    newFile.close();
+
+    // the old journal stays valid until it is replaced
+    if (!ok || ::rename(QFile::encodeName(newPath).constData(),
+                        QFile::encodeName(journalPath()).constData()) != 0) {
+        qDebug() << "[TransferJournal] cannot rewrite journal:" << strerror(errno);
+        QFile::remove(newPath);
+        return;
+    }
+
+    m_file.close();
+    m_file.setFileName(journalPath());
+    m_file.open(QFile::WriteOnly | QFile::Append);
+    m_compactedSize = m_file.size();
+    qDebug() << "[TransferJournal] journal rewritten with" << m_compactedSize << "bytes";
+}
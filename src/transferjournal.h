@@ -0,0 +1,116 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRANSFERJOURNAL_H
+#define TRANSFERJOURNAL_H
+
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief The TransferJournal class records the progress of a copy or move.
+ *
+ * The journal is a small text file that holds the plan of a transfer:
+ * the sources, the destination, and the name each source gets there.
+ * Completed files are added to it, as well as byte offsets of large files
+ * while they are copied. Once all files directly in a folder are done,
+ * a single record for the folder replaces the records of its files.
+ *
+ * Records of completed files are written in batches, at most every
+ * 250 ms. Offsets are written right away. If the journal grows too large,
+ * it is rewritten with only the records that are still needed.
+ *
+ * If the app stops during a transfer, the journal is left behind and the
+ * transfer can be resumed on the next start, skipping all files that
+ * were completed and continuing the last file at its offset. Files whose
+ * record was not written yet are simply copied again.
+ *
+ * All record methods may be called from several threads at once.
+ */
+class TransferJournal
+{
+public:
+    enum Mode {
+        NoMode, CopyMode, MoveMode
+    };
+
+    TransferJournal() = default;
+
+    static QString journalPath();
+    // true if an interrupted transfer can be resumed
+    static bool exists();
+    static void remove();
+
+    // starts a new journal, replacing an old one
+    bool begin(Mode mode, const QStringList& sources, const QString& destDirectory);
+    // reads the journal of an interrupted transfer and continues it
+    bool load();
+    // writes pending records, e.g. before the app is closed
+    void flush();
+    // closes and removes the journal
+    void finish();
+
+    Mode mode() const { return m_mode; }
+    QStringList sources() const { return m_sources; }
+    QString destDirectory() const { return m_destDirectory; }
+
+    // destination chosen for a source, empty if not decided yet
+    QString target(const QString& source) const;
+    bool isDone(const QString& source) const;
+    // bytes of a source that are known to be copied
+    qint64 offset(const QString& source) const;
+
+    void setTarget(const QString& source, const QString& target);
+    void setDone(const QString& source);
+    // all files directly in the folder are done, subfolders are not included
+    void setFolderDone(const QString& folder);
+    void setOffset(const QString& source, qint64 offset);
+
+private:
+    void clearState();
+    void markDone(const QString& source);
+    void markFolderDone(const QString& folder);
+    void append(const QByteArray& record, bool now);
+    void writeBuffer();
+    void rewrite();
+
+    mutable QMutex m_mutex;
+    QFile m_file;
+    QByteArray m_buffer;
+    QElapsedTimer m_sinceWrite;
+    qint64 m_compactedSize = {0};
+
+    Mode m_mode = {NoMode};
+    QStringList m_sources;
+    QString m_destDirectory;
+    QHash<QString, QString> m_targets;
+    QHash<QString, qint64> m_offsets;
+    QHash<QString, QSet<QString>> m_done; // file names by folder
+    QSet<QString> m_doneFolders;
+};
+
+#endif // TRANSFERJOURNAL_H
@@ -0,0 +1,160 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <QFile>
+#include <QDebug>
+#include "transferplan.h"
+
+bool TransferPlan::readDestination(const QString& destDirectory)
+{
+    struct statvfs data;
+    if (statvfs(QFile::encodeName(destDirectory).constData(), &data) != 0) {
+        qDebug() << "[TransferPlan] cannot read free space of" << destDirectory << strerror(errno);
+        return false;
+    }
+
+    m_blockSize = data.f_frsize > 0 ? qint64(data.f_frsize) : qint64(data.f_bsize);
+    m_bytesAvailable = qint64(data.f_bavail) * m_blockSize;
+
+    // some file systems, e.g. vfat, have no inode limit and report 0
+    m_inodesAvailable = data.f_files > 0 ? qint64(data.f_favail) : -1;
+    return true;
+}
+
+void TransferPlan::collect(const QStringList& paths, std::function<bool()> isCancelled)
+{
+    for (const auto& path : paths) {
+        if (isCancelled && isCancelled()) return;
+
+        QByteArray encoded = QFile::encodeName(path);
+        struct stat data;
+        if (lstat(encoded.constData(), &data) != 0) {
+            ++m_unreadable;
+            continue;
+        }
+
+        addEntry(data);
+        if (!S_ISDIR(data.st_mode)) continue;
+
+        int dirFd = open(encoded.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirFd < 0) {
+            ++m_unreadable;
+            continue;
+        }
+
+        walk(dirFd, isCancelled);
+    }
+}
+
+void TransferPlan::walk(int dirFd, const std::function<bool()>& isCancelled)
+{
+    // closedir() closes dirFd as well
+    DIR* dir = fdopendir(dirFd);
+    if (!dir) {
+        close(dirFd);
+        ++m_unreadable;
+        return;
+    }
+
+    while (struct dirent* entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        if (isCancelled && isCancelled()) break;
+
+        struct stat data;
+        if (fstatat(dirFd, entry->d_name, &data, AT_SYMLINK_NOFOLLOW) != 0) {
+            ++m_unreadable;
+            continue;
+        }
+
+        addEntry(data);
+        if (!S_ISDIR(data.st_mode)) continue;
+
+        int childFd = openat(dirFd, entry->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (childFd < 0) {
+            ++m_unreadable;
+            continue;
+        }
+
+        walk(childFd, isCancelled);
+    }
+
+    closedir(dir);
+}
+
+void TransferPlan::addEntry(const struct stat& data)
+{
+    if (S_ISDIR(data.st_mode)) {
+        ++m_folders;
+        ++m_blocks; // for the entries of the new folder
+    } else if (S_ISLNK(data.st_mode)) {
+        ++m_symlinks;
+    } else if (S_ISREG(data.st_mode)) {
+        ++m_files;
+        m_bytes += data.st_size;
+        m_blocks += (data.st_size + m_blockSize - 1) / m_blockSize;
+
+        // copies of hard links don't share their data anymore
+        if (data.st_nlink > 1) ++m_hardLinks;
+    } else {
+        ++m_specialFiles; // devices, fifos, and sockets are not copied
+    }
+}
+
+qint64 TransferPlan::bytesNeeded() const
+{
+    return m_blocks * m_blockSize;
+}
+
+bool TransferPlan::hasEnoughSpace() const
+{
+    if (m_bytesAvailable >= 0 && bytesNeeded() > m_bytesAvailable) {
+        return false;
+    }
+
+    if (m_inodesAvailable >= 0 && m_files + m_folders + m_symlinks > m_inodesAvailable) {
+        return false;
+    }
+
+    return true;
+}
+
+QVariantMap TransferPlan::toVariantMap() const
+{
+    return {
+        {QStringLiteral("bytes"), m_bytes},
+        {QStringLiteral("bytesNeeded"), bytesNeeded()},
+        {QStringLiteral("bytesAvailable"), m_bytesAvailable},
+        {QStringLiteral("files"), m_files},
+        {QStringLiteral("folders"), m_folders},
+        {QStringLiteral("symlinks"), m_symlinks},
+        {QStringLiteral("hardLinks"), m_hardLinks},
+        {QStringLiteral("specialFiles"), m_specialFiles},
+        {QStringLiteral("unreadable"), m_unreadable},
+        {QStringLiteral("enoughSpace"), hasEnoughSpace()},
+    };
+}
@@ -0,0 +1,84 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef TRANSFERPLAN_H
+#define TRANSFERPLAN_H
+
+#include <functional>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+struct stat;
+
+/**
+ * @brief The TransferPlan class describes what a copy will write.
+ *
+ * It walks all sources once, without following symlinks, and counts the
+ * bytes of regular files, folders, symlinks, files with several hard links,
+ * and special files (which are not copied). The space needed is compared
+ * against statvfs of the destination before anything is written.
+ */
+class TransferPlan
+{
+public:
+    TransferPlan() = default;
+
+    // reads the free space and block size of the destination,
+    // call this before collect() so that the space needed is exact
+    bool readDestination(const QString& destDirectory);
+    // the callback is polled regularly and stops the walk if it returns true
+    void collect(const QStringList& paths, std::function<bool()> isCancelled = {});
+
+    qint64 bytes() const { return m_bytes; }
+    int files() const { return m_files; }
+    int folders() const { return m_folders; }
+    int symlinks() const { return m_symlinks; }
+    int hardLinks() const { return m_hardLinks; }
+    int specialFiles() const { return m_specialFiles; }
+    int unreadable() const { return m_unreadable; }
+
+    // bytes rounded up to whole blocks of the destination
+    qint64 bytesNeeded() const;
+    qint64 bytesAvailable() const { return m_bytesAvailable; }
+    bool hasEnoughSpace() const;
+
+    QVariantMap toVariantMap() const;
+
+private:
+    void addEntry(const struct stat& data);
+    void walk(int dirFd, const std::function<bool()>& isCancelled);
+
+    qint64 m_bytes = {0};
+    qint64 m_blocks = {0};
+    int m_files = {0};
+    int m_folders = {0};
+    int m_symlinks = {0};
+    int m_hardLinks = {0};
+    int m_specialFiles = {0};
+    int m_unreadable = {0};
+
+    qint64 m_blockSize = {4096};
+    qint64 m_bytesAvailable = {-1};
+    qint64 m_inodesAvailable = {-1};
+};
+
+#endif // TRANSFERPLAN_H
@@ -0,0 +1,166 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cerrno>
+#include <unistd.h>
+#include <pwd.h>
+#include <grp.h>
+#include <sys/stat.h>
+#include <QVector>
+#include <QFile>
+#include "usernamecache.h"
+
+// Minimum time between checks whether the databases changed.
+#ifndef USERNAMECACHE_CHECK_INTERVAL_MSEC
+#define USERNAMECACHE_CHECK_INTERVAL_MSEC 5000
+#endif
+
+// Largest buffer tried for a single user or group entry.
+#ifndef USERNAMECACHE_MAX_BUFFER_SIZE
+#define USERNAMECACHE_MAX_BUFFER_SIZE (1024*1024)
+#endif
+
+namespace {
+qint64 modTimeOf(const char* path)
+{
+    struct stat data;
+    if (stat(path, &data) != 0) return -1;
+    return qint64(data.st_mtim.tv_sec) * 1000000000LL + data.st_mtim.tv_nsec;
+}
+
+int initialBufferSize(int sysconfName, int fallback)
+{
+    long size = sysconf(sysconfName);
+    return size > 0 ? int(qMin(size, long(USERNAMECACHE_MAX_BUFFER_SIZE))) : fallback;
+}
+}
+
+UserNameCache* UserNameCache::instance()
+{
+    static UserNameCache cache;
+    return &cache;
+}
+
+UserNameCache::UserNameCache()
+{
+}
+
+QString UserNameCache::userName(uid_t uid)
+{
+    reloadIfChanged();
+
+    {
+        QReadLocker locker(&m_lock);
+        auto it = m_users.constFind(uid);
+        if (it != m_users.constEnd()) return it.value();
+    }
+
+    // not enumerable, ask once
+    QString name;
+    struct passwd entry;
+    struct passwd* result = nullptr;
+    QVector<char> buffer(initialBufferSize(_SC_GETPW_R_SIZE_MAX, 1024));
+    int error;
+    while ((error = getpwuid_r(uid, &entry, buffer.data(), size_t(buffer.size()), &result)) == ERANGE
+           && buffer.size() < USERNAMECACHE_MAX_BUFFER_SIZE) {
+        buffer.resize(buffer.size() * 2);
+    }
+
+    // only unknown users are remembered, errors may be temporary
+    if (error != 0) return name;
+    if (result) name = QFile::decodeName(result->pw_name);
+
+    QWriteLocker locker(&m_lock);
+    m_users.insert(uid, name);
+    return name;
+}
+
+QString UserNameCache::groupName(gid_t gid)
+{
+    reloadIfChanged();
+
+    {
+        QReadLocker locker(&m_lock);
+        auto it = m_groups.constFind(gid);
+        if (it != m_groups.constEnd()) return it.value();
+    }
+
+    QString name;
+    struct group entry;
+    struct group* result = nullptr;
+    QVector<char> buffer(initialBufferSize(_SC_GETGR_R_SIZE_MAX, 4096));
+    int error;
+    while ((error = getgrgid_r(gid, &entry, buffer.data(), size_t(buffer.size()), &result)) == ERANGE
+           && buffer.size() < USERNAMECACHE_MAX_BUFFER_SIZE) {
+        buffer.resize(buffer.size() * 2); // groups can have many members
+    }
+
+    if (error != 0) return name;
+    if (result) name = QFile::decodeName(result->gr_name);
+
+    QWriteLocker locker(&m_lock);
+    m_groups.insert(gid, name);
+    return name;
+}
+
+void UserNameCache::reloadIfChanged()
+{
+    {
+        QReadLocker locker(&m_lock);
+        if (m_sinceCheck.isValid() && m_sinceCheck.elapsed() < USERNAMECACHE_CHECK_INTERVAL_MSEC) return;
+    }
+
+    QWriteLocker locker(&m_lock);
+    if (m_sinceCheck.isValid() && m_sinceCheck.elapsed() < USERNAMECACHE_CHECK_INTERVAL_MSEC) return;
+    m_sinceCheck.start();
+
+    qint64 passwdModTime = modTimeOf("/etc/passwd");
+    qint64 groupModTime = modTimeOf("/etc/group");
+    if (passwdModTime == m_passwdModTime && groupModTime == m_groupModTime) return;
+
+    m_passwdModTime = passwdModTime;
+    m_groupModTime = groupModTime;
+    reload();
+}
+
+void UserNameCache::reload()
+{
+    // The enumeration functions are not reentrant,
+    // but they are only called with the write lock held.
+    m_users.clear();
+    m_groups.clear();
+
+    setpwent();
+    while (struct passwd* entry = getpwent()) {
+        if (!m_users.contains(entry->pw_uid)) {
+            m_users.insert(entry->pw_uid, QFile::decodeName(entry->pw_name));
+        }
+    }
+    endpwent();
+
+    setgrent();
+    while (struct group* entry = getgrent()) {
+        if (!m_groups.contains(entry->gr_gid)) {
+            m_groups.insert(entry->gr_gid, QFile::decodeName(entry->gr_name));
+        }
+    }
+    endgrent();
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of File Browser.
+ *
+ * SPDX-FileCopyrightText: 2021 Mirian Margiani
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * File Browser is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * File Browser is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef USERNAMECACHE_H
+#define USERNAMECACHE_H
+
+#include <sys/types.h>
+#include <QString>
+#include <QHash>
+#include <QReadWriteLock>
+#include <QElapsedTimer>
+
+/**
+ * @brief The UserNameCache class resolves user and group ids to names.
+ *
+ * All users and groups are read once from the system databases. The
+ * cache is read again if /etc/passwd or /etc/group changed, which is
+ * checked at most every few seconds. Ids that are not listed there,
+ * e.g. from network directories, are looked up one by one and cached
+ * as well. All methods are thread-safe.
+ */
+class UserNameCache
+{
+public:
+    static UserNameCache* instance();
+
+    // returns an empty string for unknown ids
+    QString userName(uid_t uid);
+    QString groupName(gid_t gid);
+
+private:
+    explicit UserNameCache();
+    void reloadIfChanged();
+    void reload();
+
+    QReadWriteLock m_lock;
+    QHash<uid_t, QString> m_users;
+    QHash<gid_t, QString> m_groups;
+    qint64 m_passwdModTime = {-1};
+    qint64 m_groupModTime = {-1};
+    QElapsedTimer m_sinceCheck;
+};
+
+#endif // USERNAMECACHE_H